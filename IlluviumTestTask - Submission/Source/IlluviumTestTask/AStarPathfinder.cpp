@@ -1,116 +1,238 @@
 ﻿#include "AStarPathfinder.h"
-#include "Algo/Reverse.h"
-#include "Containers/Map.h"
-#include "Containers/Set.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+#include "SimulationStats.h"
 #include "HAL/Platform.h"
 
-struct FNode
+void FAStarScratch::BeginQuery(int32 NumCells)
 {
-    FIntPoint Coord;
-    float PathCost;
+    for (int32 PageIndex : UsedPages)
+    {
+        if (FreePages.Num() < MaxPooledPages)
+        {
+            FreePages.Add(MoveTemp(Pages[PageIndex]));
+        }
+        else
+        {
+            Pages[PageIndex].Reset();
+        }
+    }
+
+    UsedPages.Reset();
+
+    // Every slot is empty at this point, so the table can be resized without losing anything
+    Pages.SetNum(FMath::DivideAndRoundUp(NumCells, PageSize));
+
+    // Stamps from older generations are never equal to the new one, so pooled pages need no
+    // clearing unless the counter wraps around
+    if (++Generation == 0)
+    {
+        for (const TUniquePtr<FPage>& Page : FreePages)
+        {
+            FMemory::Memzero(Page->VisitedStamp);
+            FMemory::Memzero(Page->ClosedStamp);
+        }
+
+        Generation = 1;
+    }
+
+    Frontier.Reset();
+    ClosedCells.Reset();
+}
 
-    bool operator<(const FNode& Other) const
+void FAStarScratch::AddPage(int32 PageIndex)
+{
+    if (FreePages.Num() > 0)
+    {
+        Pages[PageIndex] = FreePages.Pop(EAllowShrinking::No);
+    }
+    else
     {
-        return PathCost < Other.PathCost;
+        // Value-initialised, so the stamps start at zero, a generation never in use
+        Pages[PageIndex] = MakeUnique<FPage>();
     }
-};
+
+    UsedPages.Add(PageIndex);
+}
+
+FAStarScratch& AStarPathfinder::GetThreadScratch()
+{
+    static thread_local FAStarScratch Scratch;
+    return Scratch;
+}
 
 TArray<FIntPoint> AStarPathfinder::FindPath(
     const FIntPoint& Start,
     const FIntPoint& Goal,
     const IGridGeometry& Geometry,
     const FIntPoint* PreviousCellBias,
-    const TSet<FIntPoint>* TempUnwalkable)
+    const FPathBlockers* Blockers)
+{
+    FAStarScratch& Scratch = GetThreadScratch();
+    if (!Search(Start, Goal, Geometry, PreviousCellBias, Blockers, Scratch))
+    {
+        return {};
+    }
+
+    const int32 GridSize = Geometry.GetGridSize();
+    return ReconstructPath(Scratch, GridSize, Goal.Y * GridSize + Goal.X);
+}
+
+bool AStarPathfinder::Search(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers,
+    FAStarScratch& Scratch,
+    int32 MaxExpanded)
 {
+    switch (Geometry.GetShape())
+    {
+    case EGridShape::Hex:
+        return Search<FHexGrid>(Start, Goal, static_cast<const FHexGrid&>(Geometry), PreviousCellBias, Blockers, Scratch, MaxExpanded);
+    case EGridShape::Square:
+    default:
+        return Search<FSquareGrid>(Start, Goal, static_cast<const FSquareGrid&>(Geometry), PreviousCellBias, Blockers, Scratch, MaxExpanded);
+    }
+}
+
+template<typename GeometryType>
+bool AStarPathfinder::Search(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const GeometryType& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers,
+    FAStarScratch& Scratch,
+    int32 MaxExpanded)
+{
+    SIMULATION_SCOPE(FindPath);
+
     const int32 GridSize = Geometry.GetGridSize();
-    const int32 MaxSteps = GridSize * GridSize;
+    const int32 MaxSteps = FMath::Min(GridSize * GridSize, FMath::Min(MaxExpanded, MaxExpandedNodes));
     int32 StepsTaken = 0;
 
-    TArray<FNode> Frontier;
-    TSet<FIntPoint> FrontierSet;
-    TSet<FIntPoint> ClosedSet;
+    auto IsInGrid = [GridSize](const FIntPoint& Cell)
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    };
+
+    if (!IsInGrid(Start) || !IsInGrid(Goal))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("A* could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
+        SimulationStats::RecordSearch(0, false, false);
+        return false;
+    }
+
+    Scratch.BeginQuery(GridSize * GridSize);
 
-    TMap<FIntPoint, FIntPoint> CameFrom;
-    TMap<FIntPoint, float> CostSoFar;
+    const int32 StartIndex = Start.Y * GridSize + Start.X;
+    const int32 GoalIndex = Goal.Y * GridSize + Goal.X;
+    const int32 PreviousIndex = (PreviousCellBias && IsInGrid(*PreviousCellBias))
+        ? PreviousCellBias->Y * GridSize + PreviousCellBias->X
+        : INDEX_NONE;
 
-    Frontier.HeapPush(FNode{ Start, 0.0f });
-    FrontierSet.Add(Start);
-    CameFrom.Add(Start, Start);
-    CostSoFar.Add(Start, 0.0f);
+    Scratch.Frontier.HeapPush(FAStarScratch::FNode{ StartIndex, 0.0f });
+    Scratch.Visit(StartIndex, StartIndex, 0.0f);
 
-    while (!Frontier.IsEmpty())
+    while (!Scratch.Frontier.IsEmpty())
     {
         StepsTaken++;
         if (StepsTaken > MaxSteps)
         {
-            UE_LOG(LogTemp, Error, TEXT("A* exceeded max steps. Start: %s Goal: %s"), *Start.ToString(), *Goal.ToString());
-            return {};
+            // A lowered limit is the caller's bet on a local search, so running past it is expected
+            if (MaxExpanded < MaxExpandedNodes)
+            {
+                UE_LOG(LogTemp, Verbose, TEXT("A* exceeded max steps. Start: %s Goal: %s"), *Start.ToString(), *Goal.ToString());
+            }
+            else
+            {
+                UE_LOG(LogTemp, Warning, TEXT("A* exceeded max steps. Start: %s Goal: %s"), *Start.ToString(), *Goal.ToString());
+            }
+
+            SimulationStats::RecordSearch(Scratch.ClosedCells.Num(), false, true);
+            return false;
         }
 
-        FNode Current;
-        Frontier.HeapPop(Current, true);
-        FrontierSet.Remove(Current.Coord);
+        FAStarScratch::FNode Current;
+        Scratch.Frontier.HeapPop(Current, EAllowShrinking::No);
 
-        if (ClosedSet.Contains(Current.Coord))
+        if (Scratch.IsClosed(Current.Index))
             continue;
 
-        ClosedSet.Add(Current.Coord);
+        Scratch.Close(Current.Index);
 
-        if (Current.Coord == Goal)
+        if (Current.Index == GoalIndex)
         {
-            return ReconstructPath(CameFrom, Goal);
+            SimulationStats::RecordSearch(Scratch.ClosedCells.Num(), true, false);
+            return true;
         }
 
-        float CurrentCost = CostSoFar[Current.Coord];
+        const float CurrentCost = Scratch.GetCost(Current.Index);
+        const FIntPoint CurrentCoord(Current.Index % GridSize, Current.Index / GridSize);
 
-        for (const FIntPoint& Neighbor : Geometry.GetNeighbors(Current.Coord))
+        Geometry.ForEachNeighbor(CurrentCoord, [&](const FIntPoint& Neighbor)
         {
-            if (TempUnwalkable && TempUnwalkable->Contains(Neighbor))
-                continue;
+            if (!IsInGrid(Neighbor))
+                return;
+
+            if (Blockers && Blockers->IsBlocked(Neighbor))
+                return;
 
-            if (ClosedSet.Contains(Neighbor))
-                continue;
+            const int32 NeighborIndex = Neighbor.Y * GridSize + Neighbor.X;
+            if (Scratch.IsClosed(NeighborIndex))
+                return;
 
             float NewCost = CurrentCost + 1.0f;
 
             //Set a high penalty for returning to the previous cell in order to prevent oscillating with close targets
-            if (PreviousCellBias && Neighbor == *PreviousCellBias)
+            if (NeighborIndex == PreviousIndex)
                 NewCost += 10000.0f;
 
-            float* ExistingCost = CostSoFar.Find(Neighbor);
-            if (!ExistingCost || NewCost < *ExistingCost)
+            // A visited cell that is not closed is always still in the frontier, so it is only pushed on its first visit
+            const bool bVisited = Scratch.IsVisited(NeighborIndex);
+            if (!bVisited || NewCost < Scratch.GetCost(NeighborIndex))
             {
-                CostSoFar.Add(Neighbor, NewCost);
-                CameFrom.Add(Neighbor, Current.Coord);
+                Scratch.Visit(NeighborIndex, Current.Index, NewCost);
 
-                if (!FrontierSet.Contains(Neighbor))
+                if (!bVisited)
                 {
-                    float Priority = NewCost + Geometry.HeuristicDistance(Neighbor, Goal);
-                    Frontier.HeapPush(FNode{ Neighbor, Priority });
-                    FrontierSet.Add(Neighbor);
+                    float Priority = NewCost + Geometry.Heuristic(Neighbor, Goal);
+                    Scratch.Frontier.HeapPush(FAStarScratch::FNode{ NeighborIndex, Priority });
                 }
             }
-        }
+        });
     }
 
     UE_LOG(LogTemp, Warning, TEXT("A* could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
-    return {};
+    SimulationStats::RecordSearch(Scratch.ClosedCells.Num(), false, false);
+    return false;
 }
 
+template bool AStarPathfinder::Search<FSquareGrid>(const FIntPoint&, const FIntPoint&, const FSquareGrid&, const FIntPoint*, const FPathBlockers*, FAStarScratch&, int32);
+template bool AStarPathfinder::Search<FHexGrid>(const FIntPoint&, const FIntPoint&, const FHexGrid&, const FIntPoint*, const FPathBlockers*, FAStarScratch&, int32);
+
 TArray<FIntPoint> AStarPathfinder::ReconstructPath(
-    const TMap<FIntPoint, FIntPoint>& CameFrom,
-    const FIntPoint& Current) const
+    const FAStarScratch& Scratch,
+    int32 GridSize,
+    int32 GoalIndex)
 {
+    int32 PathLength = 1;
+    for (int32 Step = GoalIndex; Scratch.GetCameFrom(Step) != Step; Step = Scratch.GetCameFrom(Step))
+    {
+        ++PathLength;
+    }
+
     TArray<FIntPoint> Path;
-    FIntPoint Step = Current;
+    Path.SetNumUninitialized(PathLength);
 
-    while (CameFrom.Contains(Step) && CameFrom[Step] != Step)
+    int32 Step = GoalIndex;
+    for (int32 i = PathLength - 1; i >= 0; --i)
     {
-        Path.Add(Step);
-        Step = CameFrom[Step];
+        Path[i] = FIntPoint(Step % GridSize, Step / GridSize);
+        Step = Scratch.GetCameFrom(Step);
     }
 
-    Path.Add(Step);
-    Algo::Reverse(Path);
     return Path;
 }
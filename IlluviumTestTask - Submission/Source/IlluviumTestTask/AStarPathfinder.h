@@ -3,19 +3,184 @@
 #include "IPathfinder.h"
 #include "MyGridManager.h"
 
+/*
+====================================================================================
+  FAStarScratch - Reusable A* Search State
+====================================================================================
+
+- Cells are addressed by dense index (Y * GridSize + X). Cost, parent and closed state
+  are kept in pages of PageSize consecutive indices, and a page is only handed out the
+  first time a query visits one of its cells, so memory follows the area searched
+  rather than the grid size.
+- An entry only counts as written when its stamp matches the current Generation.
+  BeginQuery() returns the pages of the last query to a pool without clearing them,
+  so every query starts from a clean state without touching the whole grid.
+- One instance is kept per thread (see AStarPathfinder::GetThreadScratch()).
+- ClosedCells lists the cells closed by the last query in expansion order, so callers
+  can read the search tree back without scanning the whole grid.
+
+Notes:
+- A page takes 16 KB. The page table costs one pointer per PageSize cells (512 KB on an
+  8192 x 8192 grid) and at most MaxPooledPages pages are kept between queries.
+*/
+
+struct FAStarScratch
+{
+    struct FNode
+    {
+        int32 Index;
+        float PathCost;
+
+        bool operator<(const FNode& Other) const
+        {
+            return PathCost < Other.PathCost;
+        }
+    };
+
+    static constexpr int32 PageShift = 10;
+    static constexpr int32 PageSize = 1 << PageShift;
+    static constexpr int32 PageMask = PageSize - 1;
+    static constexpr int32 MaxPooledPages = 256;
+
+    // Releases the pages of the last query, sizes the page table for NumCells and starts a new generation
+    void BeginQuery(int32 NumCells);
+
+    FORCEINLINE bool IsVisited(int32 Index) const
+    {
+        const FPage* Page = Pages[Index >> PageShift].Get();
+        return Page && Page->VisitedStamp[Index & PageMask] == Generation;
+    }
+
+    FORCEINLINE bool IsClosed(int32 Index) const
+    {
+        const FPage* Page = Pages[Index >> PageShift].Get();
+        return Page && Page->ClosedStamp[Index & PageMask] == Generation;
+    }
+
+    // Only valid for cells visited by the current query
+    FORCEINLINE float GetCost(int32 Index) const { return Pages[Index >> PageShift]->CostSoFar[Index & PageMask]; }
+    FORCEINLINE int32 GetCameFrom(int32 Index) const { return Pages[Index >> PageShift]->CameFrom[Index & PageMask]; }
+
+    FORCEINLINE void Visit(int32 Index, int32 Parent, float Cost)
+    {
+        TUniquePtr<FPage>& Page = Pages[Index >> PageShift];
+        if (!Page)
+        {
+            AddPage(Index >> PageShift);
+        }
+
+        Page->VisitedStamp[Index & PageMask] = Generation;
+        Page->CameFrom[Index & PageMask] = Parent;
+        Page->CostSoFar[Index & PageMask] = Cost;
+    }
+
+    // Index has to be visited first, which is what gives it a page
+    FORCEINLINE void Close(int32 Index)
+    {
+        Pages[Index >> PageShift]->ClosedStamp[Index & PageMask] = Generation;
+        ClosedCells.Add(Index);
+    }
+
+    TArray<FNode> Frontier;
+    TArray<int32> ClosedCells;
+
+private:
+    struct FPage
+    {
+        float CostSoFar[PageSize];
+        int32 CameFrom[PageSize];
+        uint32 VisitedStamp[PageSize];
+        uint32 ClosedStamp[PageSize];
+    };
+
+    // Takes a page from the pool, or allocates one, for the page table slot PageIndex
+    void AddPage(int32 PageIndex);
+
+    // One slot per PageSize cells, null until the current query visits one of them
+    TArray<TUniquePtr<FPage>> Pages;
+
+    // Slots filled since the last BeginQuery()
+    TArray<int32> UsedPages;
+
+    // Released pages; their stamps all belong to older generations
+    TArray<TUniquePtr<FPage>> FreePages;
+
+    uint32 Generation = 0;
+};
+
 class AStarPathfinder : public IPathfinder
 {
 public:
+    // Picks the search specialised for Geometry's shape on every call, see TAStarPathfinder
     TArray<FIntPoint> FindPath(
         const FIntPoint& Start,
         const FIntPoint& Goal,
         const IGridGeometry& Geometry,
         const FIntPoint* PreviousCell = nullptr,
-        const TSet<FIntPoint>* TempUnwalkable = nullptr);
+        const FPathBlockers* Blockers = nullptr);
 
-private:
+    // Every thread searches in its own scratch
+    virtual bool SupportsConcurrentQueries() const override { return true; }
+
+    // A search gives up after expanding this many cells, so an unreachable goal cannot
+    // flood a large grid. Grids up to 1024 x 1024 are always searched in full.
+    static constexpr int32 MaxExpandedNodes = 1 << 20;
+
+    // Runs the search into Scratch. On success the path can be read back by following
+    // Scratch.GetCameFrom() from the goal index until an index points to itself.
+    // MaxExpanded lowers the expansion limit for searches expected to stay local.
+    static bool Search(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCell,
+        const FPathBlockers* Blockers,
+        FAStarScratch& Scratch,
+        int32 MaxExpanded = MaxExpandedNodes);
+
+    // Same search against a concrete geometry, with its neighbours and heuristic inlined.
+    // Instantiated for FSquareGrid and FHexGrid.
+    template<typename GeometryType>
+    static bool Search(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const GeometryType& Geometry,
+        const FIntPoint* PreviousCell,
+        const FPathBlockers* Blockers,
+        FAStarScratch& Scratch,
+        int32 MaxExpanded = MaxExpandedNodes);
+
+    static FAStarScratch& GetThreadScratch();
+
+    // Reads the path to GoalIndex back out of a successful Search()
+    static TArray<FIntPoint> ReconstructPath(
+        const FAStarScratch& Scratch,
+        int32 GridSize,
+        int32 GoalIndex);
+};
+
+// A* bound to one concrete geometry, chosen once when the simulation is set up.
+// Must only be handed geometries of that type.
+template<typename GeometryType>
+class TAStarPathfinder final : public AStarPathfinder
+{
+public:
+    virtual TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCell = nullptr,
+        const FPathBlockers* Blockers = nullptr) override
+    {
+        checkSlow(Geometry.GetShape() == GeometryType::Shape);
+
+        FAStarScratch& Scratch = GetThreadScratch();
+        if (!Search<GeometryType>(Start, Goal, static_cast<const GeometryType&>(Geometry), PreviousCell, Blockers, Scratch))
+        {
+            return {};
+        }
 
-    TArray<FIntPoint> ReconstructPath(
-        const TMap<FIntPoint, FIntPoint>& CameFrom,
-        const FIntPoint& Current) const;
-};
\ No newline at end of file
+        const int32 GridSize = Geometry.GetGridSize();
+        return ReconstructPath(Scratch, GridSize, Goal.Y * GridSize + Goal.X);
+    }
+};
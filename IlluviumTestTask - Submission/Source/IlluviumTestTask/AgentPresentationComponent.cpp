@@ -0,0 +1,382 @@
+#include "AgentPresentationComponent.h"
+#include "BallAgent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/Actor.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+namespace
+{
+    // Material parameters that stand in for the custom data slots when agents are not instanced
+    const FName CustomDataParameters[] = { NAME_None, TEXT("HealthTintAmount"), TEXT("FlashAlpha") };
+}
+
+UAgentPresentationComponent::UAgentPresentationComponent()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UAgentPresentationComponent::Initialize(TSubclassOf<ABallAgent> InArchetype)
+{
+    AActor* Owner = GetOwner();
+    if (!Owner || !Owner->GetRootComponent())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Agent presentation needs an owning actor with a root component."));
+        return;
+    }
+
+    const ABallAgent* Archetype = InArchetype ? InArchetype->GetDefaultObject<ABallAgent>() : GetDefault<ABallAgent>();
+    const UStaticMeshComponent* ArchetypeMesh = Archetype->GetMeshComponent();
+    if (!ArchetypeMesh || !ArchetypeMesh->GetStaticMesh())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Agent class %s has no static mesh."), *GetNameSafe(InArchetype.Get()));
+        return;
+    }
+
+    MeshTransform = ArchetypeMesh->GetRelativeTransform();
+    MoveSpeed = Archetype->GetMoveSpeed();
+    LungeDistance = ABallAgent::AttackLungeDistance;
+    bInstanced = Archetype->DoMaterialsReadInstanceCustomData();
+    bInitialized = true;
+
+    if (!bInstanced)
+    {
+        // The team materials only have scalar parameters for the tint and flash, which one instanced mesh cannot vary per agent
+        AgentMesh = ArchetypeMesh->GetStaticMesh();
+        TeamMaterials[static_cast<int32>(ETeam::Red)] = Archetype->GetTeamMaterial(ETeam::Red);
+        TeamMaterials[static_cast<int32>(ETeam::Blue)] = Archetype->GetTeamMaterial(ETeam::Blue);
+        return;
+    }
+
+    for (ETeam Team : { ETeam::Red, ETeam::Blue })
+    {
+        UInstancedStaticMeshComponent* Instances = NewObject<UInstancedStaticMeshComponent>(Owner);
+        Instances->SetStaticMesh(ArchetypeMesh->GetStaticMesh());
+        if (UMaterialInterface* Material = Archetype->GetTeamMaterial(Team))
+        {
+            Instances->SetMaterial(0, Material);
+        }
+        Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+        Instances->SetNumCustomDataFloats(CustomData_Num);
+        Instances->SetupAttachment(Owner->GetRootComponent());
+        Instances->RegisterComponent();
+        Owner->AddInstanceComponent(Instances);
+
+        TeamInstances.Add(Instances);
+    }
+}
+
+void UAgentPresentationComponent::AddAgent(int32 AgentId, ETeam InTeam, const FVector& Location)
+{
+    if (!ensureMsgf(AgentId == TeamIndex.Num(), TEXT("Agents must be presented in id order")) || !bInitialized)
+        return;
+
+    const int32 Team = static_cast<int32>(InTeam);
+    const FTransform Transform = MeshTransform * FTransform(Location);
+
+    TeamIndex.Add(static_cast<uint8>(Team));
+
+    if (bInstanced)
+    {
+        InstanceIndex.Add(TeamInstances[Team]->AddInstance(Transform, true));
+    }
+    else
+    {
+        AActor* Owner = GetOwner();
+        UStaticMeshComponent* AgentMeshComponent = NewObject<UStaticMeshComponent>(Owner);
+        AgentMeshComponent->SetStaticMesh(AgentMesh);
+        AgentMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+        AgentMeshComponent->SetupAttachment(Owner->GetRootComponent());
+        AgentMeshComponent->SetWorldTransform(Transform);
+        if (TeamMaterials[Team])
+        {
+            AgentMeshComponent->SetMaterial(0, TeamMaterials[Team]);
+        }
+        AgentMeshComponent->RegisterComponent();
+
+        InstanceIndex.Add(AgentMeshes.Add(AgentMeshComponent));
+        AgentMaterials.Add(nullptr);
+    }
+
+    bVisible.Add(true);
+    Action.Add(EVisualAction::None);
+    SegmentStart.Add(Location);
+    SegmentEnd.Add(Location);
+    SegmentProgress.Add(0.f);
+    LogicalLocation.Add(Location);
+    TargetLocation.Add(Location);
+    VisualLocation.Add(Location);
+    FlashTimer.Add(0.f);
+    CustomData.AddZeroed(CustomData_Num);
+    InstanceTransforms[Team].Add(Transform);
+
+    SetCustomData(AgentId, CustomData_Team, static_cast<float>(Team));
+}
+
+void UAgentPresentationComponent::ClearAgents()
+{
+    for (UInstancedStaticMeshComponent* Instances : TeamInstances)
+    {
+        if (IsValid(Instances))
+        {
+            Instances->ClearInstances();
+        }
+    }
+
+    for (UStaticMeshComponent* AgentMeshComponent : AgentMeshes)
+    {
+        if (IsValid(AgentMeshComponent))
+        {
+            AgentMeshComponent->DestroyComponent();
+        }
+    }
+
+    AgentMeshes.Reset();
+    AgentMaterials.Reset();
+    TeamIndex.Reset();
+    InstanceIndex.Reset();
+    bVisible.Reset();
+    Action.Reset();
+    SegmentStart.Reset();
+    SegmentEnd.Reset();
+    SegmentProgress.Reset();
+    LogicalLocation.Reset();
+    TargetLocation.Reset();
+    VisualLocation.Reset();
+    FlashTimer.Reset();
+    CustomData.Reset();
+
+    for (int32 Team = 0; Team < NumTeams; ++Team)
+    {
+        InstanceTransforms[Team].Reset();
+        DirtyBegin[Team] = MAX_int32;
+        DirtyEnd[Team] = INDEX_NONE;
+        bCustomDataDirty[Team] = false;
+    }
+}
+
+void UAgentPresentationComponent::MoveAgent(int32 AgentId, const FVector& InTargetLocation)
+{
+    // The simulation decides when the agent moves again; a visual still catching up restarts from the logical cell
+    SegmentStart[AgentId] = LogicalLocation[AgentId];
+    SegmentEnd[AgentId] = InTargetLocation;
+    SegmentProgress[AgentId] = 0.f;
+    LogicalLocation[AgentId] = InTargetLocation;
+    Action[AgentId] = EVisualAction::Moving;
+}
+
+void UAgentPresentationComponent::BeginAttack(int32 AgentId, const FVector& InTargetLocation)
+{
+    const FVector Direction = (InTargetLocation - LogicalLocation[AgentId]).GetSafeNormal();
+
+    SegmentStart[AgentId] = LogicalLocation[AgentId];
+    SegmentEnd[AgentId] = LogicalLocation[AgentId] + Direction * LungeDistance;
+    SegmentProgress[AgentId] = 0.f;
+    Action[AgentId] = EVisualAction::AttackPending;
+}
+
+void UAgentPresentationComponent::StrikeAttack(int32 AgentId)
+{
+    if (Action[AgentId] == EVisualAction::AttackPending)
+    {
+        Action[AgentId] = EVisualAction::AttackLunge;
+    }
+}
+
+void UAgentPresentationComponent::CancelAttack(int32 AgentId)
+{
+    Action[AgentId] = EVisualAction::None;
+    TargetLocation[AgentId] = LogicalLocation[AgentId];
+}
+
+void UAgentPresentationComponent::ShowDamage(int32 AgentId, int32 HP, int32 MaxHP)
+{
+    if (HP > 0 && MaxHP > 0)
+    {
+        SetCustomData(AgentId, CustomData_HealthTint, 1.f - static_cast<float>(HP) / static_cast<float>(MaxHP));
+    }
+
+    FlashTimer[AgentId] = FlashDuration;
+    SetCustomData(AgentId, CustomData_Flash, 1.f);
+}
+
+void UAgentPresentationComponent::RemoveAgent(int32 AgentId)
+{
+    bVisible[AgentId] = false;
+    Action[AgentId] = EVisualAction::None;
+
+    FTransform Hidden = MeshTransform * FTransform(VisualLocation[AgentId]);
+    Hidden.SetScale3D(FVector::ZeroVector);
+    SetInstanceTransform(AgentId, Hidden);
+}
+
+void UAgentPresentationComponent::SnapAgent(int32 AgentId, const FVector& Location, int32 HP, int32 MaxHP)
+{
+    Action[AgentId] = EVisualAction::None;
+    SegmentStart[AgentId] = Location;
+    SegmentEnd[AgentId] = Location;
+    SegmentProgress[AgentId] = 0.f;
+    LogicalLocation[AgentId] = Location;
+    TargetLocation[AgentId] = Location;
+    VisualLocation[AgentId] = Location;
+    FlashTimer[AgentId] = 0.f;
+    SetCustomData(AgentId, CustomData_Flash, 0.f);
+
+    if (HP <= 0)
+    {
+        RemoveAgent(AgentId);
+        return;
+    }
+
+    bVisible[AgentId] = true;
+    SetCustomData(AgentId, CustomData_HealthTint, MaxHP > 0 ? 1.f - static_cast<float>(HP) / static_cast<float>(MaxHP) : 0.f);
+    SetInstanceTransform(AgentId, MeshTransform * FTransform(Location));
+}
+
+void UAgentPresentationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (!bInitialized)
+        return;
+
+    const int32 NumAgents = TeamIndex.Num();
+    for (int32 Id = 0; Id < NumAgents; ++Id)
+    {
+        if (!bVisible[Id])
+            continue;
+
+        const EVisualAction CurrentAction = Action[Id];
+        if (CurrentAction == EVisualAction::Moving || CurrentAction == EVisualAction::AttackLunge || CurrentAction == EVisualAction::AttackReturn)
+        {
+            // Lunge out at three times and back at twice the move speed
+            const float Speed = CurrentAction == EVisualAction::AttackLunge ? MoveSpeed * 3.f
+                : CurrentAction == EVisualAction::AttackReturn ? MoveSpeed * 2.f
+                : MoveSpeed;
+
+            const float SegmentLength = FVector::Dist(SegmentStart[Id], SegmentEnd[Id]);
+            SegmentProgress[Id] = SegmentLength > KINDA_SMALL_NUMBER ? SegmentProgress[Id] + DeltaTime * Speed / SegmentLength : 1.f;
+            TargetLocation[Id] = FMath::Lerp(SegmentStart[Id], SegmentEnd[Id], FMath::Min(SegmentProgress[Id], 1.f));
+
+            if (SegmentProgress[Id] >= 1.f)
+            {
+                if (CurrentAction == EVisualAction::AttackLunge)
+                {
+                    Swap(SegmentStart[Id], SegmentEnd[Id]);
+                    SegmentProgress[Id] = 0.f;
+                    Action[Id] = EVisualAction::AttackReturn;
+                }
+                else
+                {
+                    Action[Id] = EVisualAction::None;
+                }
+            }
+        }
+
+        const FVector NewVisualLocation = FMath::VInterpTo(VisualLocation[Id], TargetLocation[Id], DeltaTime, InterpSpeed);
+        if (!NewVisualLocation.Equals(VisualLocation[Id], 0.01f))
+        {
+            VisualLocation[Id] = NewVisualLocation;
+            SetInstanceTransform(Id, MeshTransform * FTransform(NewVisualLocation));
+        }
+
+        if (FlashTimer[Id] > 0.f)
+        {
+            FlashTimer[Id] -= DeltaTime;
+            SetCustomData(Id, CustomData_Flash, FMath::Clamp(FlashTimer[Id] / FlashDuration, 0.f, 1.f));
+        }
+    }
+
+    // Without instancing every change was already applied to the agent's own component
+    if (!bInstanced)
+        return;
+
+    for (int32 Team = 0; Team < NumTeams; ++Team)
+    {
+        UInstancedStaticMeshComponent* Instances = TeamInstances[Team];
+
+        if (DirtyBegin[Team] <= DirtyEnd[Team])
+        {
+            PushScratch.Reset();
+            PushScratch.Append(InstanceTransforms[Team].GetData() + DirtyBegin[Team], DirtyEnd[Team] - DirtyBegin[Team] + 1);
+            Instances->BatchUpdateInstancesTransforms(DirtyBegin[Team], PushScratch, true, true, false);
+
+            DirtyBegin[Team] = MAX_int32;
+            DirtyEnd[Team] = INDEX_NONE;
+            bCustomDataDirty[Team] = false;
+        }
+        else if (bCustomDataDirty[Team])
+        {
+            Instances->MarkRenderStateDirty();
+            bCustomDataDirty[Team] = false;
+        }
+    }
+}
+
+void UAgentPresentationComponent::SetCustomData(int32 AgentId, int32 Index, float Value)
+{
+    float& Current = CustomData[AgentId * CustomData_Num + Index];
+    if (Current == Value)
+        return;
+
+    Current = Value;
+
+    if (!bInstanced)
+    {
+        if (Index != CustomData_Team)
+        {
+            if (UMaterialInstanceDynamic* Material = GetOrCreateAgentMaterial(AgentId))
+            {
+                Material->SetScalarParameterValue(CustomDataParameters[Index], Value);
+            }
+        }
+        return;
+    }
+
+    const int32 Team = TeamIndex[AgentId];
+    TeamInstances[Team]->SetCustomDataValue(InstanceIndex[AgentId], Index, Value, false);
+    bCustomDataDirty[Team] = true;
+}
+
+void UAgentPresentationComponent::SetInstanceTransform(int32 AgentId, const FTransform& Transform)
+{
+    if (!bInstanced)
+    {
+        // Rotation and scale come from the archetype and never change; a zero scale only means hidden
+        UStaticMeshComponent* AgentMeshComponent = AgentMeshes[AgentId];
+        const bool bShow = !Transform.GetScale3D().IsNearlyZero();
+        if (AgentMeshComponent->IsVisible() != bShow)
+        {
+            AgentMeshComponent->SetVisibility(bShow);
+        }
+
+        if (bShow && !AgentMeshComponent->GetComponentLocation().Equals(Transform.GetLocation()))
+        {
+            AgentMeshComponent->SetWorldLocation(Transform.GetLocation());
+        }
+        return;
+    }
+
+    const int32 Team = TeamIndex[AgentId];
+    const int32 Instance = InstanceIndex[AgentId];
+
+    InstanceTransforms[Team][Instance] = Transform;
+    DirtyBegin[Team] = FMath::Min(DirtyBegin[Team], Instance);
+    DirtyEnd[Team] = FMath::Max(DirtyEnd[Team], Instance);
+}
+
+UMaterialInstanceDynamic* UAgentPresentationComponent::GetOrCreateAgentMaterial(int32 AgentId)
+{
+    UMaterialInstanceDynamic* Material = AgentMaterials[AgentId];
+    if (!Material)
+    {
+        UMaterialInterface* TeamMaterial = TeamMaterials[TeamIndex[AgentId]];
+        if (!TeamMaterial)
+            return nullptr;
+
+        Material = UMaterialInstanceDynamic::Create(TeamMaterial, this);
+        AgentMeshes[AgentId]->SetMaterial(0, Material);
+        AgentMaterials[AgentId] = Material;
+    }
+
+    return Material;
+}
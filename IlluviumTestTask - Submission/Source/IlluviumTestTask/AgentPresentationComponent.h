@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "SimulationTypes.h"
+#include "AgentPresentationComponent.generated.h"
+
+class ABallAgent;
+class UInstancedStaticMeshComponent;
+class UMaterialInstanceDynamic;
+
+/*
+====================================================================================
+  UAgentPresentationComponent - Batched Agent Visuals
+====================================================================================
+
+- Draws every agent of the simulation as an instance of one instanced static mesh
+  component per team, using the mesh and team materials of the ABallAgent archetype.
+- Until the archetype's team materials read per-instance custom data
+  (ABallAgent::bMaterialsReadInstanceCustomData), every agent gets a mesh component of
+  its own instead. It is drawn with the shared team material, so undamaged agents can
+  still be instanced by the renderer, and gets a dynamic material instance the first
+  time its health tint or flash (the HealthTintAmount and FlashAlpha parameters) changes.
+- USimulationSystem reports what happens (moves, attacks, damage, deaths) by agent id;
+  the visual state is kept in one array per field, indexed by that id.
+- One tick updates every agent in a single pass and pushes the changed transforms
+  to each team's component in one batch.
+
+Per-instance custom data:
+  0 - Team index
+  1 - Health tint (0 at full health, towards 1 as HP drops)
+  2 - Damage flash alpha
+
+Notes:
+- Custom data is only written when a value changes. Without instancing the team is
+  given by the material and slot 0 is not written anywhere; only an agent's location and
+  visibility are written to its component, and only when they change.
+- Dead agents keep their instance slot and are hidden by a zero scale, so instance
+  indices never shift.
+*/
+
+UCLASS()
+class UAgentPresentationComponent : public UActorComponent
+{
+    GENERATED_BODY()
+
+public:
+    UAgentPresentationComponent();
+
+    // Creates the per-team instanced meshes from the archetype's defaults
+    void Initialize(TSubclassOf<ABallAgent> InArchetype);
+
+    // Agents have to be added in id order
+    void AddAgent(int32 AgentId, ETeam InTeam, const FVector& Location);
+    void ClearAgents();
+
+    void MoveAgent(int32 AgentId, const FVector& TargetLocation);
+
+    // Attack towards TargetLocation: holds still until StrikeAttack(), then lunges and returns
+    void BeginAttack(int32 AgentId, const FVector& TargetLocation);
+    void StrikeAttack(int32 AgentId);
+    void CancelAttack(int32 AgentId);
+
+    void ShowDamage(int32 AgentId, int32 HP, int32 MaxHP);
+    void RemoveAgent(int32 AgentId);
+
+    // Puts the agent straight at Location with no action running, e.g. after a snapshot restore.
+    // Agents with no HP left are hidden.
+    void SnapAgent(int32 AgentId, const FVector& Location, int32 HP, int32 MaxHP);
+
+    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+    enum class EVisualAction : uint8
+    {
+        None,
+        Moving,
+        AttackPending,
+        AttackLunge,
+        AttackReturn
+    };
+
+    enum ECustomData : int32
+    {
+        CustomData_Team,
+        CustomData_HealthTint,
+        CustomData_Flash,
+        CustomData_Num
+    };
+
+    void SetCustomData(int32 AgentId, int32 Index, float Value);
+    void SetInstanceTransform(int32 AgentId, const FTransform& Transform);
+
+    // Without instancing: the agent's own material, created from the team material on first use
+    UMaterialInstanceDynamic* GetOrCreateAgentMaterial(int32 AgentId);
+
+    // Set by Initialize() once it could read the archetype
+    bool bInitialized = false;
+    bool bInstanced = false;
+
+    UPROPERTY()
+    TArray<TObjectPtr<UInstancedStaticMeshComponent>> TeamInstances;
+
+    // Without instancing: the archetype's looks, and one mesh and material per agent id (null while
+    // the agent still uses the team material)
+    UPROPERTY()
+    TObjectPtr<UStaticMesh> AgentMesh;
+
+    UPROPERTY()
+    TObjectPtr<UMaterialInterface> TeamMaterials[NumTeams];
+
+    UPROPERTY()
+    TArray<TObjectPtr<UStaticMeshComponent>> AgentMeshes;
+
+    UPROPERTY()
+    TArray<TObjectPtr<UMaterialInstanceDynamic>> AgentMaterials;
+
+    FTransform MeshTransform;
+    float MoveSpeed = 130.f;
+    float LungeDistance = 25.f;
+
+    static constexpr float FlashDuration = 0.2f;
+    static constexpr float InterpSpeed = 10.f;
+
+    // Visual state, indexed by agent id
+    TArray<uint8> TeamIndex;
+    TArray<int32> InstanceIndex;
+    TArray<bool> bVisible;
+    TArray<EVisualAction> Action;
+    TArray<FVector> SegmentStart;
+    TArray<FVector> SegmentEnd;
+    TArray<float> SegmentProgress;
+    TArray<FVector> LogicalLocation;
+    TArray<FVector> TargetLocation;
+    TArray<FVector> VisualLocation;
+    TArray<float> FlashTimer;
+    TArray<float> CustomData;
+
+    // Per team: instance transforms and the range changed since the last push
+    TArray<FTransform> InstanceTransforms[NumTeams];
+    int32 DirtyBegin[NumTeams] = { MAX_int32, MAX_int32 };
+    int32 DirtyEnd[NumTeams] = { INDEX_NONE, INDEX_NONE };
+    bool bCustomDataDirty[NumTeams] = {};
+    TArray<FTransform> PushScratch;
+};
@@ -2,70 +2,33 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "SimulationTypes.h"
 #include "BallAgent.generated.h"
 
 /*
 ====================================================================================
-  ABallAgent - Agent Actor for Simulation
+  ABallAgent - Agent Archetype
 ====================================================================================
 
-- Represents a single agent on the grid, belonging to either the Red or Blue team.
-- Maintains logical and visual positions for clean interpolation.
-- Updates per tick for animation, movement, and attack feedback.
-
-Core Responsibilities:
- Movement:
-    - Interpolates between grid cells using MoveToWorldLocation() and FollowPath().
-    - Uses CurrentLogicalWorldPosition for simulation logic and CurrentVisualWorldPosition for rendering.
-
- Combat:
-    - Executes attack animations toward enemies.
-    - Triggers damage via OnAttackImpact delegate.
-    - Manages state transitions (Idle, Moving, WaitingForCombat, InCombat, Dead).
-
- Damage Handling:
-    - Updates health.
-    - Triggers visual feedback (material flash).
-    - Broadcasts OnDeathEvent() on death.
-
- Team Assignment:
-    - Sets team material on spawn via SetTeam().
-
-TODO:
-- Extract visual logic (e.g., material flash, color based on HP)
-  and health/damage logic into separate Actor Components to improve modularity and testability.
+- Describes what every agent of USimulationSystem is and looks like; it is not spawned
+  per agent. The simulation and UAgentPresentationComponent read its class defaults.
+- The simulation owns the agent's state (FSimAgentStore), and all agents are drawn
+  in one batch by UAgentPresentationComponent, so there is no per-agent tick.
+
+Class Defaults:
+ Rules:
+    - MoveSpeed, AttackCooldown and PauseBeforeCombatDuration are the values
+      USimulationSystem runs its rules with.
+
+ Looks:
+    - Mesh is the mesh every agent instance is drawn with (including its relative offset).
+    - RedMaterial / BlueMaterial are the team materials. They show the health tint and
+      damage flash through the HealthTintAmount and FlashAlpha scalar parameters, or,
+      with bMaterialsReadInstanceCustomData, through per-instance custom data (see
+      UAgentPresentationComponent).
 */
 
 
-UENUM(BlueprintType)
-enum class ETeam : uint8
-{
-    Red,
-    Blue
-};
-
-UENUM(BlueprintType)
-enum class EAgentState : uint8
-{
-    Idle,
-    Moving,
-    WaitingForCombat,
-    InCombat,
-    Dead
-};
-
-USTRUCT()
-struct FAgentDamageContext
-{
-    GENERATED_BODY()
-
-    int32 Amount;
-    TWeakObjectPtr<class ABallAgent> Instigator;
-};
-
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAgentDied, ABallAgent*, Agent);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAttackImpact, ABallAgent*, Attacker);
-
 UCLASS()
 class ABallAgent : public AActor
 {
@@ -74,54 +37,18 @@ class ABallAgent : public AActor
 public:
     ABallAgent();
 
-    void Initialize(const FVector& StartWorldPosition, int32 InHP);
-    void SetTeam(ETeam InTeam);
-    void SetState(EAgentState NewState);
-    void MoveToWorldLocation(const FVector& TargetWorldLocation);
-    void SetPath(const TArray<FVector>& InWorldPath);
-    bool TryAttack(ABallAgent* Enemy, int32 Damage, const FVector& EnemyWorldLocation);
-    void ReceiveDamage(const FAgentDamageContext& Context);
-    bool IsAlive() const;
-    bool CanAttack() const;
-    void ResetAttackCooldown();
-
-    FORCEINLINE EAgentState GetState() const { return CurrentState; }
-    FORCEINLINE ETeam GetTeam() const { return Team; }
-    FORCEINLINE ABallAgent* GetQueuedCombatTarget() const { return QueuedCombatTarget.Get(); }
-    FORCEINLINE int32 GetPendingDamage() const { return PendingDamageToDeal; }
-
-    FORCEINLINE FVector GetCurrentWorldPosition() const { return CurrentLogicalWorldPosition; }
-
-    void SetCurrentLogicalWorldPosition(const FVector& NewPosition)
-    {
-        CurrentLogicalWorldPosition = NewPosition;
-    }
+    FORCEINLINE const UStaticMeshComponent* GetMeshComponent() const { return Mesh; }
+    UMaterialInterface* GetTeamMaterial(ETeam InTeam) const;
+    FORCEINLINE bool DoMaterialsReadInstanceCustomData() const { return bMaterialsReadInstanceCustomData; }
 
-    FORCEINLINE void SetPreviousWorldPosition(const FVector& Pos) { PreviousLogicalWorldPosition = Pos; }
+    // Rules read by USimulationSystem from the class defaults
+    FORCEINLINE float GetMoveSpeed() const { return MoveSpeed; }
+    FORCEINLINE float GetAttackCooldown() const { return AttackCooldown; }
+    FORCEINLINE float GetPauseBeforeCombatDuration() const { return PauseBeforeCombatDuration; }
+    float GetAttackAnimationDuration() const;
 
-    FOnAgentDied& OnDeathEvent() { return DeathEvent; }
-
-    UPROPERTY(BlueprintAssignable)
-    FOnAttackImpact OnAttackImpact;
-
-protected:
-    virtual void BeginPlay() override;
-    virtual void Tick(float DeltaTime) override;
-
-    void PlayAttackAnimationTowards(const FVector& TargetWorldLocation);
-    void UpdateAttackAnimation(float DeltaTime);
-    void FollowPath(float DeltaTime);
-
-    void SetQueuedCombatTarget(ABallAgent* Target);
-    void ClearQueuedCombatTarget();
-    void OnDeath();
-
-    void UpdateMaterialFlash(float DeltaTime);
-
-    void UpdateBaseColorBasedOnHealth();
-
-    UFUNCTION()
-    void HandleTargetAgentDeath(ABallAgent* DeadAgent);
+    // How far the attack animation lunges towards the target
+    static constexpr float AttackLungeDistance = 25.f;
 
 protected:
     UPROPERTY(VisibleAnywhere)
@@ -142,48 +69,8 @@ protected:
     UPROPERTY(EditDefaultsOnly)
     UMaterialInterface* BlueMaterial;
 
-    UPROPERTY()
-    UMaterialInstanceDynamic* DynamicMaterial;
-
-    ETeam Team;
-    EAgentState CurrentState = EAgentState::Idle;
-
-    int32 MaxHP = 1;
-    int32 HP = 1;
-    float TimeSinceLastAttack = 0.f;
-
-    float DamageFlashTimer = 0.f;
-    const float DamageFlashDuration = 0.2f;
-
-    // Movement
-    TArray<FVector> WorldPath;
-    int32 CurrentPathIndex = 0;
-    bool bMoving = false;
-    float Progress = 0.f;
-
-    FVector StartPosition;
-    FVector EndPosition;
-
-    // Logical movement
-    FVector CurrentLogicalWorldPosition;
-    FVector PreviousLogicalWorldPosition;
-
-    // Visual smoothing
-    FVector CurrentVisualWorldPosition;
-
-    // Attack animation
-    bool bIsAttacking = false;
-    FVector AttackStart;
-    FVector AttackEnd;
-    int32 AttackPhase = 0;
-    float AttackProgress = 0.f;
-
-    // Delayed combat transition
-    float PauseBeforeCombatTimer = 0.f;
-
-    // Target handling
-    TWeakObjectPtr<ABallAgent> QueuedCombatTarget;
-    int32 PendingDamageToDeal = 0;
-
-    FOnAgentDied DeathEvent;
+    // Set once both team materials read the health tint and flash from PerInstanceCustomData 1 and 2,
+    // which lets every agent of a team be drawn as one instanced mesh
+    UPROPERTY(EditDefaultsOnly)
+    bool bMaterialsReadInstanceCustomData = false;
 };
@@ -6,32 +6,11 @@ FHexGrid::FHexGrid(int InGridSize, float InTileSize)
 {
 }
 
-TArray<FIntPoint> FHexGrid::GetNeighbors(const FIntPoint& Cell) const
+FGridNeighbors FHexGrid::GetNeighbors(const FIntPoint& Cell) const
 {
-    const bool bOddRow = Cell.Y % 2 != 0;
-
-    if (bOddRow)
-    {
-        return {
-            Cell + FIntPoint(+1,  0),
-            Cell + FIntPoint(0, +1),
-            Cell + FIntPoint(+1, +1),
-            Cell + FIntPoint(-1,  0),
-            Cell + FIntPoint(0, -1),
-            Cell + FIntPoint(+1, -1),
-        };
-    }
-    else
-    {
-        return {
-            Cell + FIntPoint(+1,  0),
-            Cell + FIntPoint(-1, +1),
-            Cell + FIntPoint(0, +1),
-            Cell + FIntPoint(-1,  0),
-            Cell + FIntPoint(-1, -1),
-            Cell + FIntPoint(0, -1),
-        };
-    }
+    FGridNeighbors Neighbors;
+    ForEachNeighbor(Cell, [&Neighbors](const FIntPoint& Neighbor) { Neighbors.Add(Neighbor); });
+    return Neighbors;
 }
 
 FVector FHexGrid::GetTileWorldPosition(const FIntPoint& Cell, const FVector& GridOrigin) const
@@ -71,20 +50,11 @@ FIntPoint FHexGrid::WorldToGrid(const FVector& WorldLocation) const
 
 float FHexGrid::HeuristicDistance(const FIntPoint& A, const FIntPoint& B) const
 {
-    FIntVector ACube = CubeFromOffset(A);
-    FIntVector BCube = CubeFromOffset(B);
-
-    int dx = FMath::Abs(ACube.X - BCube.X);
-    int dy = FMath::Abs(ACube.Y - BCube.Y);
-    int dz = FMath::Abs(ACube.Z - BCube.Z);
-
-    return (dx + dy + dz) / 2.0f;
+    return Heuristic(A, B);
 }
 
-TArray<FIntPoint> FHexGrid::GetCellsInRange(const FIntPoint& Center, int32 Range) const
+void FHexGrid::GetCellsInRange(const FIntPoint& Center, int32 Range, TStepArray<FIntPoint>& OutCells) const
 {
-    TArray<FIntPoint> Result;
-
     FIntVector CenterCube = CubeFromOffset(Center);
 
     for (int dx = -Range; dx <= Range; ++dx)
@@ -93,11 +63,38 @@ TArray<FIntPoint> FHexGrid::GetCellsInRange(const FIntPoint& Center, int32 Range
         {
             int dz = -dx - dy;
             FIntVector Cube = FIntVector(CenterCube.X + dx, CenterCube.Y + dy, CenterCube.Z + dz);
-            Result.Add(OffsetFromCube(Cube));
+            OutCells.Add(OffsetFromCube(Cube));
+        }
+    }
+}
+
+void FHexGrid::GetCellsInRing(const FIntPoint& Center, int32 Ring, TStepArray<FIntPoint>& OutCells) const
+{
+    FIntVector CenterCube = CubeFromOffset(Center);
+
+    // Same loop as GetCellsInRange; inside the ring only the two ends of each dy span lie on it
+    for (int dx = -Ring; dx <= Ring; ++dx)
+    {
+        const int MinDy = FMath::Max(-Ring, -dx - Ring);
+        const int MaxDy = FMath::Min(Ring, -dx + Ring);
+        const int DyStep = (FMath::Abs(dx) == Ring) ? 1 : FMath::Max(MaxDy - MinDy, 1);
+
+        for (int dy = MinDy; dy <= MaxDy; dy += DyStep)
+        {
+            int dz = -dx - dy;
+            FIntVector Cube = FIntVector(CenterCube.X + dx, CenterCube.Y + dy, CenterCube.Z + dz);
+            OutCells.Add(OffsetFromCube(Cube));
         }
     }
+}
 
-    return Result;
+int32 FHexGrid::GetDistanceLowerBound(const FIntPoint& Delta) const
+{
+    // Every row crossed can also shift the column by at most half a cell, so columns
+    // beyond ceil(rows / 2) each cost one extra step
+    const int32 Rows = FMath::Abs(Delta.Y);
+    const int32 Cols = FMath::Abs(Delta.X);
+    return Rows + FMath::Max(0, Cols - (Rows + 1) / 2);
 }
 
 FIntVector FHexGrid::CubeFromOffset(const FIntPoint& Offset) const
@@ -3,20 +3,52 @@
 #include "CoreMinimal.h"
 #include "IGridGeometry.h"
 
-class FHexGrid : public IGridGeometry
+class FHexGrid final : public IGridGeometry
 {
 public:
+    static constexpr EGridShape Shape = EGridShape::Hex;
+    static constexpr int32 NumNeighbors = 6;
+
     explicit FHexGrid(int GridSize, float InHexSize);
 
-    virtual TArray<FIntPoint> GetNeighbors(const FIntPoint& Cell) const override;
+    // Calls Func for each of the 6 neighbours of Cell, in GetNeighbors() order
+    template<typename FunctionType>
+    FORCEINLINE void ForEachNeighbor(const FIntPoint& Cell, FunctionType&& Func) const
+    {
+        const int32 (&Offsets)[NumNeighbors][2] = NeighborOffsets[Cell.Y & 1];
+        for (int32 i = 0; i < NumNeighbors; ++i)
+        {
+            Func(FIntPoint(Cell.X + Offsets[i][0], Cell.Y + Offsets[i][1]));
+        }
+    }
+
+    // Cube distance, computed from the offset coordinates without building both cubes
+    FORCEINLINE float Heuristic(const FIntPoint& A, const FIntPoint& B) const
+    {
+        const int32 DX = (A.X - (A.Y - (A.Y & 1)) / 2) - (B.X - (B.Y - (B.Y & 1)) / 2);
+        const int32 DZ = A.Y - B.Y;
+        return (FMath::Abs(DX) + FMath::Abs(DZ) + FMath::Abs(DX + DZ)) / 2.0f;
+    }
+
+    virtual EGridShape GetShape() const override { return Shape; }
+    virtual FGridNeighbors GetNeighbors(const FIntPoint& Cell) const override;
     virtual FIntPoint WorldToGrid(const FVector& WorldLocation) const override;
     virtual FVector GetTileWorldPosition(const FIntPoint& Cell, const FVector& GridOrigin) const override;
     virtual float GetTileSize() const override { return TileSize; }
     virtual int GetGridSize() const override { return GridSize; }
-    virtual TArray<FIntPoint> GetCellsInRange(const FIntPoint& Center, int32 Range) const override;
+    virtual void GetCellsInRange(const FIntPoint& Center, int32 Range, TStepArray<FIntPoint>& OutCells) const override;
+    virtual void GetCellsInRing(const FIntPoint& Center, int32 Ring, TStepArray<FIntPoint>& OutCells) const override;
+    virtual int32 GetDistanceLowerBound(const FIntPoint& Delta) const override;
     virtual float HeuristicDistance(const FIntPoint& A, const FIntPoint& B) const override;
 
 private:
+    // Odd-r neighbour offsets, indexed by row parity (even, odd)
+    static constexpr int32 NeighborOffsets[2][NumNeighbors][2] =
+    {
+        { { +1, 0 }, { -1, +1 }, { 0, +1 }, { -1, 0 }, { -1, -1 }, { 0, -1 } },
+        { { +1, 0 }, { 0, +1 }, { +1, +1 }, { -1, 0 }, { 0, -1 }, { +1, -1 } }
+    };
+
     // Converts an odd-r offset coordinate to a cube coordinate
     FIntVector CubeFromOffset(const FIntPoint& Offset) const;
 
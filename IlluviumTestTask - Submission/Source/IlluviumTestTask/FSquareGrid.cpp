@@ -5,14 +5,11 @@ FSquareGrid::FSquareGrid(int InGridSize, float InTileSize)
 {
 }
 
-TArray<FIntPoint> FSquareGrid::GetNeighbors(const FIntPoint& Cell) const
+FGridNeighbors FSquareGrid::GetNeighbors(const FIntPoint& Cell) const
 {
-    return {
-        Cell + FIntPoint(1, 0),
-        Cell + FIntPoint(-1, 0),
-        Cell + FIntPoint(0, 1),
-        Cell + FIntPoint(0, -1)
-    };
+    FGridNeighbors Neighbors;
+    ForEachNeighbor(Cell, [&Neighbors](const FIntPoint& Neighbor) { Neighbors.Add(Neighbor); });
+    return Neighbors;
 }
 
 FIntPoint FSquareGrid::WorldToGrid(const FVector& WorldLocation) const
@@ -24,20 +21,41 @@ FIntPoint FSquareGrid::WorldToGrid(const FVector& WorldLocation) const
     return FIntPoint(X, Y);
 }
 
-TArray<FIntPoint> FSquareGrid::GetCellsInRange(const FIntPoint& Center, int32 Range) const
+void FSquareGrid::GetCellsInRange(const FIntPoint& Center, int32 Range, TStepArray<FIntPoint>& OutCells) const
 {
-    TArray<FIntPoint> Result;
-
     for (int32 dx = -Range; dx <= Range; ++dx)
     {
         for (int32 dy = -Range; dy <= Range; ++dy)
         {
             if (FMath::Abs(dx) + FMath::Abs(dy) > Range) continue;
-            Result.Add(Center + FIntPoint(dx, dy));
+            OutCells.Add(Center + FIntPoint(dx, dy));
         }
     }
+}
 
-    return Result;
+void FSquareGrid::GetCellsInRing(const FIntPoint& Center, int32 Ring, TStepArray<FIntPoint>& OutCells) const
+{
+    if (Ring == 0)
+    {
+        OutCells.Add(Center);
+        return;
+    }
+
+    // Same dx-major, dy-ascending order as GetCellsInRange, limited to |dx| + |dy| == Ring
+    for (int32 dx = -Ring; dx <= Ring; ++dx)
+    {
+        const int32 dy = Ring - FMath::Abs(dx);
+        OutCells.Add(Center + FIntPoint(dx, -dy));
+        if (dy != 0)
+        {
+            OutCells.Add(Center + FIntPoint(dx, dy));
+        }
+    }
+}
+
+int32 FSquareGrid::GetDistanceLowerBound(const FIntPoint& Delta) const
+{
+    return FMath::Abs(Delta.X) + FMath::Abs(Delta.Y); // Manhattan distance is exact
 }
 
 FVector FSquareGrid::GetTileWorldPosition(const FIntPoint& Cell, const FVector& GridOrigin) const
@@ -47,5 +65,5 @@ FVector FSquareGrid::GetTileWorldPosition(const FIntPoint& Cell, const FVector&
 
 float FSquareGrid::HeuristicDistance(const FIntPoint& A, const FIntPoint& B) const
 {
-    return FMath::Abs(A.X - B.X) + FMath::Abs(A.Y - B.Y); // Manhattan distance
+    return Heuristic(A, B);
 }
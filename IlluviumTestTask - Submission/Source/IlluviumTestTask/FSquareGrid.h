@@ -4,20 +4,43 @@
 #include "CoreMinimal.h"
 #include "IGridGeometry.h"
 
-class FSquareGrid : public IGridGeometry
+class FSquareGrid final : public IGridGeometry
 {
 public:
+    static constexpr EGridShape Shape = EGridShape::Square;
+    static constexpr int32 NumNeighbors = 4;
+
     explicit FSquareGrid(int GridSize, float InTileSize);
 
-    virtual TArray<FIntPoint> GetNeighbors(const FIntPoint& Cell) const override;
+    // Calls Func for each of the 4 orthogonal neighbours of Cell, in GetNeighbors() order
+    template<typename FunctionType>
+    FORCEINLINE void ForEachNeighbor(const FIntPoint& Cell, FunctionType&& Func) const
+    {
+        for (int32 i = 0; i < NumNeighbors; ++i)
+        {
+            Func(FIntPoint(Cell.X + NeighborOffsets[i][0], Cell.Y + NeighborOffsets[i][1]));
+        }
+    }
+
+    FORCEINLINE float Heuristic(const FIntPoint& A, const FIntPoint& B) const
+    {
+        return FMath::Abs(A.X - B.X) + FMath::Abs(A.Y - B.Y); // Manhattan distance
+    }
+
+    virtual EGridShape GetShape() const override { return Shape; }
+    virtual FGridNeighbors GetNeighbors(const FIntPoint& Cell) const override;
     virtual FVector GetTileWorldPosition(const FIntPoint& Cell, const FVector& GridOrigin) const override;
     virtual FIntPoint WorldToGrid(const FVector& WorldLocation) const override;
-    virtual TArray<FIntPoint> GetCellsInRange(const FIntPoint& Center, int32 Range) const override;
+    virtual void GetCellsInRange(const FIntPoint& Center, int32 Range, TStepArray<FIntPoint>& OutCells) const override;
+    virtual void GetCellsInRing(const FIntPoint& Center, int32 Ring, TStepArray<FIntPoint>& OutCells) const override;
+    virtual int32 GetDistanceLowerBound(const FIntPoint& Delta) const override;
     virtual float GetTileSize() const override { return TileSize; }
     virtual int GetGridSize() const override { return GridSize; }
     virtual float HeuristicDistance(const FIntPoint& A, const FIntPoint& B) const override;
 
 private:
+    static constexpr int32 NeighborOffsets[NumNeighbors][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
     float TileSize;
     int GridSize;
 };
@@ -12,6 +12,15 @@ enum class EGridType : uint8
     Hex UMETA(DisplayName = "Hex Grid")
 };
 
+UENUM(BlueprintType)
+enum class EPathfinderType : uint8
+{
+    AStar UMETA(DisplayName = "A*"),
+    Hierarchical UMETA(DisplayName = "Hierarchical (HPA*)"),
+    JumpPoint UMETA(DisplayName = "Jump Point Search (square grids only)"),
+    Incremental UMETA(DisplayName = "Incremental (D* Lite per agent)")
+};
+
 UCLASS(BlueprintType)
 class UGridGeometryConfig : public UDataAsset
 {
@@ -29,4 +38,19 @@ public:
 
     UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Grid")
     float TileSize = 100.f;
+
+    // Cells no agent can stand on or path through; they get no floor tile
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Grid")
+    TArray<FIntPoint> StaticObstacles;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pathfinding")
+    EPathfinderType PathfinderType = EPathfinderType::AStar;
+
+    // Cells per side of one HPA* cluster; larger clusters mean a smaller abstract graph but costlier refinement
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pathfinding", meta = (ClampMin = "4", EditCondition = "PathfinderType == EPathfinderType::Hierarchical"))
+    int32 HierarchicalClusterSize = 16;
+
+    // Cells one agent's D* Lite search may touch before it is dropped in favour of plain A*
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pathfinding", meta = (ClampMin = "64", EditCondition = "PathfinderType == EPathfinderType::Incremental"))
+    int32 IncrementalMaxNodesPerAgent = 8192;
 };
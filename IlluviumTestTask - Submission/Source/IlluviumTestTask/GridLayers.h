@@ -0,0 +1,134 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+====================================================================================
+  FGridLayers - Dense bit layers of the cells paths may not enter
+====================================================================================
+
+- Two layers over the grid: static obstacles, set once when the grid is initialised,
+  and occupancy, which follows the agents as they spawn, move and die.
+- Each layer is stored twice, by rows (bit X of line Y) and by columns (bit Y of
+  line X), so a scan along either axis reads 64 cells per word.
+- FPathBlockers is what pathfinders are handed: the layers plus the cells whose
+  occupancy one query ignores, i.e. the searching agent's own cell and its target's.
+  Building one costs nothing, whatever the number of agents.
+
+Notes:
+- Only written from the sequential part of a step (UMyGridManager); the decision
+  phase reads it from several threads at once.
+- A static obstacle is never made walkable by FPathBlockers' ignored cells.
+*/
+
+class FGridLayers
+{
+public:
+    enum class ELayer : uint8
+    {
+        Static,
+        Occupancy,
+        Num
+    };
+
+    // Resizes to InGridSize and clears both layers
+    void Reset(int32 InGridSize)
+    {
+        GridSize = InGridSize;
+        WordsPerLine = FMath::DivideAndRoundUp(GridSize, 64);
+
+        for (FBitLayer& Layer : Layers)
+        {
+            Layer.Rows.Init(0, GridSize * WordsPerLine);
+            Layer.Columns.Init(0, GridSize * WordsPerLine);
+        }
+    }
+
+    // Out-of-grid cells are ignored
+    void Set(ELayer Layer, const FIntPoint& Cell, bool bValue)
+    {
+        if (!IsInGrid(Cell))
+            return;
+
+        FBitLayer& Bits = Layers[static_cast<int32>(Layer)];
+        const uint64 RowBit = uint64(1) << (Cell.X & 63);
+        const uint64 ColumnBit = uint64(1) << (Cell.Y & 63);
+        uint64& RowWord = Bits.Rows[Cell.Y * WordsPerLine + (Cell.X >> 6)];
+        uint64& ColumnWord = Bits.Columns[Cell.X * WordsPerLine + (Cell.Y >> 6)];
+
+        RowWord = bValue ? RowWord | RowBit : RowWord & ~RowBit;
+        ColumnWord = bValue ? ColumnWord | ColumnBit : ColumnWord & ~ColumnBit;
+    }
+
+    // Cell has to be in the grid
+    FORCEINLINE bool IsSet(ELayer Layer, const FIntPoint& Cell) const
+    {
+        return (Layers[static_cast<int32>(Layer)].Rows[Cell.Y * WordsPerLine + (Cell.X >> 6)] >> (Cell.X & 63)) & 1;
+    }
+
+    FORCEINLINE bool IsStaticBlocked(const FIntPoint& Cell) const { return IsSet(ELayer::Static, Cell); }
+    FORCEINLINE bool IsOccupied(const FIntPoint& Cell) const { return IsSet(ELayer::Occupancy, Cell); }
+
+    FORCEINLINE bool IsInGrid(const FIntPoint& Cell) const
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    }
+
+    FORCEINLINE const uint64* GetRow(ELayer Layer, int32 Y) const { return Layers[static_cast<int32>(Layer)].Rows.GetData() + Y * WordsPerLine; }
+    FORCEINLINE const uint64* GetColumn(ELayer Layer, int32 X) const { return Layers[static_cast<int32>(Layer)].Columns.GetData() + X * WordsPerLine; }
+
+    int32 GetGridSize() const { return GridSize; }
+    int32 GetWordsPerLine() const { return WordsPerLine; }
+
+private:
+    struct FBitLayer
+    {
+        TArray<uint64> Rows;
+        TArray<uint64> Columns;
+    };
+
+    FBitLayer Layers[static_cast<int32>(ELayer::Num)];
+    int32 GridSize = 0;
+    int32 WordsPerLine = 0;
+};
+
+struct FPathBlockers
+{
+    FPathBlockers() = default;
+
+    explicit FPathBlockers(const FGridLayers& InLayers, bool bInIncludeOccupancy = true)
+        : Layers(&InLayers)
+        , bIncludeOccupancy(bInIncludeOccupancy)
+    {
+    }
+
+    // Lets the query pass through Cell even though an agent stands on it; at most two cells
+    FPathBlockers& IgnoreOccupant(const FIntPoint& Cell)
+    {
+        check(NumIgnored < MaxIgnored);
+        Ignored[NumIgnored++] = Cell;
+        return *this;
+    }
+
+    FORCEINLINE bool IsIgnored(const FIntPoint& Cell) const
+    {
+        return (NumIgnored > 0 && Cell == Ignored[0]) || (NumIgnored > 1 && Cell == Ignored[1]);
+    }
+
+    // Cell has to be in the grid
+    FORCEINLINE bool IsBlocked(const FIntPoint& Cell) const
+    {
+        return Layers
+            && (Layers->IsStaticBlocked(Cell)
+                || (bIncludeOccupancy && Layers->IsOccupied(Cell) && !IsIgnored(Cell)));
+    }
+
+    const FGridLayers* Layers = nullptr;
+
+    // Without occupancy only the static obstacles block
+    bool bIncludeOccupancy = true;
+
+    static constexpr int32 MaxIgnored = 2;
+    FIntPoint Ignored[MaxIgnored];
+    int32 NumIgnored = 0;
+};
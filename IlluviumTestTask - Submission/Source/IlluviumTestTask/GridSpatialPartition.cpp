@@ -1,67 +1,158 @@
 #include "GridSpatialPartition.h"
-#include "BallAgent.h"
+
+UGridSpatialPartition::FChunk::FChunk()
+{
+    for (int32& AgentId : CellToAgent)
+    {
+        AgentId = INDEX_NONE;
+    }
+
+    FMemory::Memzero(TeamOccupancy);
+    FMemory::Memzero(TeamBlockCounts);
+}
 
 void UGridSpatialPartition::Initialize(int32 InGridSize)
 {
     GridSize = InGridSize;
-    CellsToAgents.Empty();
+    Clear();
 }
 
-void UGridSpatialPartition::RegisterAgent(ABallAgent* Agent, const FIntPoint& Cell)
+void UGridSpatialPartition::RegisterAgent(int32 AgentId, ETeam Team, const FIntPoint& Cell)
 {
-    if (!Agent) return;
+    if (AgentId == INDEX_NONE || !IsInGrid(Cell)) return;
+
+    FChunk& Chunk = FindOrAddChunk(Cell);
 
     // Prevent adding duplicate
-    if (!CellsToAgents.FindOrAdd(Cell).Contains(Agent))
+    const int32 Existing = Chunk.CellToAgent[ToLocalIndex(Cell)];
+    if (Existing != INDEX_NONE)
     {
-        CellsToAgents.FindOrAdd(Cell).Add(Agent);
+        ensureMsgf(Existing == AgentId, TEXT("Cell %s is already occupied by another agent"), *Cell.ToString());
+        return;
     }
+
+    PlaceAgent(Chunk, AgentId, static_cast<int32>(Team), Cell);
 }
 
-void UGridSpatialPartition::UpdateAgentCell(ABallAgent* Agent, const FIntPoint& OldCell, const FIntPoint& NewCell)
+void UGridSpatialPartition::UpdateAgentCell(int32 AgentId, const FIntPoint& OldCell, const FIntPoint& NewCell)
 {
-    if (!Agent) return;
+    FChunk* OldChunk = FindChunk(OldCell);
+    if (AgentId == INDEX_NONE || !OldChunk || OldChunk->CellToAgent[ToLocalIndex(OldCell)] != AgentId)
+    {
+        ensureMsgf(false, TEXT("Agent %d is not registered at %s"), AgentId, *OldCell.ToString());
+        return;
+    }
 
-    // Remove from old cell
-    if (TSet<ABallAgent*>* OldSet = CellsToAgents.Find(OldCell))
+    if (NewCell == OldCell) return;
+
+    if (!ensureMsgf(IsInGrid(NewCell), TEXT("Agent moved outside of the grid to %s"), *NewCell.ToString()))
     {
-        OldSet->Remove(Agent);
-        if (OldSet->Num() == 0)
-        {
-            CellsToAgents.Remove(OldCell);
-        }
+        return;
     }
 
+    FChunk& NewChunk = FindOrAddChunk(NewCell);
+    if (!ensureMsgf(NewChunk.CellToAgent[ToLocalIndex(NewCell)] == INDEX_NONE, TEXT("Cell %s is already occupied by another agent"), *NewCell.ToString()))
+    {
+        return;
+    }
+
+    const uint64 OldBit = uint64(1) << (OldCell.X & ChunkMask);
+    const int32 Team = (OldChunk->TeamOccupancy[static_cast<int32>(ETeam::Red)][OldCell.Y & ChunkMask] & OldBit)
+        ? static_cast<int32>(ETeam::Red)
+        : static_cast<int32>(ETeam::Blue);
+
+    // Remove from old cell
+    ClearCell(*OldChunk, OldCell);
+
     // Add to new cell
-    CellsToAgents.FindOrAdd(NewCell).Add(Agent);
+    PlaceAgent(NewChunk, AgentId, Team, NewCell);
 }
 
-void UGridSpatialPartition::RemoveAgent(ABallAgent* Agent, const FIntPoint& Cell)
+void UGridSpatialPartition::RemoveAgent(int32 AgentId, const FIntPoint& Cell)
 {
-    if (!Agent) return;
+    FChunk* Chunk = FindChunk(Cell);
+    if (AgentId == INDEX_NONE || !Chunk || Chunk->CellToAgent[ToLocalIndex(Cell)] != AgentId) return;
 
-    if (TSet<ABallAgent*>* Set = CellsToAgents.Find(Cell))
-    {
-        Set->Remove(Agent);
-        if (Set->Num() == 0)
-        {
-            CellsToAgents.Remove(Cell);
-        }
-    }
+    ClearCell(*Chunk, Cell);
 }
 
 void UGridSpatialPartition::Clear()
 {
-    CellsToAgents.Empty();
+    ChunksPerSide = FMath::DivideAndRoundUp(GridSize, ChunkSize);
+
+    Chunks.Reset();
+    Chunks.SetNum(ChunksPerSide * ChunksPerSide);
+    NumAllocatedChunks = 0;
+
+    for (int32 Team = 0; Team < NumTeams; ++Team)
+    {
+        TeamChunkCounts[Team].Init(0, ChunksPerSide * ChunksPerSide);
+        TeamAgentCounts[Team] = 0;
+    }
 }
 
 bool UGridSpatialPartition::IsCellOccupied(const FIntPoint& Cell) const
 {
-    const TSet<ABallAgent*>* Set = CellsToAgents.Find(Cell);
-    return Set && Set->Num() > 0;
+    const FChunk* Chunk = FindChunk(Cell);
+    return Chunk && Chunk->CellToAgent[ToLocalIndex(Cell)] != INDEX_NONE;
+}
+
+bool UGridSpatialPartition::IsCellOccupiedByTeam(const FIntPoint& Cell, ETeam Team) const
+{
+    const FChunk* Chunk = FindChunk(Cell);
+    return Chunk && ((Chunk->TeamOccupancy[static_cast<int32>(Team)][Cell.Y & ChunkMask] >> (Cell.X & ChunkMask)) & 1);
+}
+
+int32 UGridSpatialPartition::GetAgentAt(const FIntPoint& Cell) const
+{
+    const FChunk* Chunk = FindChunk(Cell);
+    return Chunk ? Chunk->CellToAgent[ToLocalIndex(Cell)] : INDEX_NONE;
+}
+
+int32 UGridSpatialPartition::GetTeamBlockCount(ETeam Team, int32 BlockX, int32 BlockY) const
+{
+    const FChunk* Chunk = Chunks[(BlockY / BlocksPerChunk) * ChunksPerSide + BlockX / BlocksPerChunk].Get();
+    return Chunk
+        ? Chunk->TeamBlockCounts[static_cast<int32>(Team)][(BlockY % BlocksPerChunk) * BlocksPerChunk + BlockX % BlocksPerChunk]
+        : 0;
+}
+
+UGridSpatialPartition::FChunk& UGridSpatialPartition::FindOrAddChunk(const FIntPoint& Cell)
+{
+    TUniquePtr<FChunk>& Chunk = Chunks[ToChunkIndex(Cell)];
+    if (!Chunk)
+    {
+        Chunk = MakeUnique<FChunk>();
+        ++NumAllocatedChunks;
+    }
+
+    return *Chunk;
 }
 
-const TSet<ABallAgent*>* UGridSpatialPartition::GetAgentsAt(const FIntPoint& Cell) const
+void UGridSpatialPartition::PlaceAgent(FChunk& Chunk, int32 AgentId, int32 Team, const FIntPoint& Cell)
 {
-    return CellsToAgents.Find(Cell);
-}
\ No newline at end of file
+    Chunk.CellToAgent[ToLocalIndex(Cell)] = AgentId;
+    Chunk.TeamOccupancy[Team][Cell.Y & ChunkMask] |= uint64(1) << (Cell.X & ChunkMask);
+    ++Chunk.TeamBlockCounts[Team][ToLocalBlockIndex(Cell)];
+    ++TeamChunkCounts[Team][ToChunkIndex(Cell)];
+    ++TeamAgentCounts[Team];
+}
+
+void UGridSpatialPartition::ClearCell(FChunk& Chunk, const FIntPoint& Cell)
+{
+    const uint64 Bit = uint64(1) << (Cell.X & ChunkMask);
+
+    for (int32 Team = 0; Team < NumTeams; ++Team)
+    {
+        uint64& Row = Chunk.TeamOccupancy[Team][Cell.Y & ChunkMask];
+        if (Row & Bit)
+        {
+            Row &= ~Bit;
+            --Chunk.TeamBlockCounts[Team][ToLocalBlockIndex(Cell)];
+            --TeamChunkCounts[Team][ToChunkIndex(Cell)];
+            --TeamAgentCounts[Team];
+        }
+    }
+
+    Chunk.CellToAgent[ToLocalIndex(Cell)] = INDEX_NONE;
+}
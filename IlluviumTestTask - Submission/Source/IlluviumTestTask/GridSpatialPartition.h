@@ -1,7 +1,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "BallAgent.h"
+#include "SimulationTypes.h"
 #include "GridSpatialPartition.generated.h"
 
 /*
@@ -9,12 +9,24 @@
   UGridSpatialPartition - Lightweight Spatial Partitioning System
 ====================================================================================
 
-- Lightweight UObject storing agents by grid cell.
+- Lightweight UObject storing agent ids (see FSimAgentStore) by grid cell.
 - Allows optimized spatial queries for agent lookup and occupancy checks.
-*/
+- Cells are stored in ChunkSize x ChunkSize chunks, allocated the first time an agent
+  is registered in them, so memory and set-up follow where the armies are rather
+  than the grid size. Within a chunk each cell holds the id of the one agent standing
+  on it, so register, move, remove and lookups are plain array accesses.
+- Each chunk mirrors which of its cells hold an agent of each team as one bit row per
+  line, and keeps an agent count per team and BlockSize x BlockSize block.
+- Every chunk, allocated or not, has an agent count per team, which lets queries skip
+  empty regions a chunk at a time and then a block at a time.
 
+Notes:
+- A chunk stays allocated once created, until Clear(), so agents crossing a chunk
+  border back and forth do not allocate every time.
+- An allocated chunk takes about 17 KB; an 8192 x 8192 grid costs 256 KB before the
+  first agent is registered.
+*/
 
-class ABallAgent;
 
 UCLASS()
 class UGridSpatialPartition : public UObject
@@ -24,19 +36,105 @@ class UGridSpatialPartition : public UObject
 public:
     void Initialize(int32 InGridSize);
 
-    void RegisterAgent(ABallAgent* Agent, const FIntPoint& Cell);
+    void RegisterAgent(int32 AgentId, ETeam Team, const FIntPoint& Cell);
 
-    void UpdateAgentCell(ABallAgent* Agent, const FIntPoint& OldCell, const FIntPoint& NewCell);
+    void UpdateAgentCell(int32 AgentId, const FIntPoint& OldCell, const FIntPoint& NewCell);
 
-    void RemoveAgent(ABallAgent* Agent, const FIntPoint& Cell);
+    void RemoveAgent(int32 AgentId, const FIntPoint& Cell);
 
+    // Drops every chunk
     void Clear();
 
     bool IsCellOccupied(const FIntPoint& Cell) const;
 
-    const TSet<ABallAgent*>* GetAgentsAt(const FIntPoint& Cell) const;
+    bool IsCellOccupiedByTeam(const FIntPoint& Cell, ETeam Team) const;
+
+    // Id of the agent standing on Cell, INDEX_NONE if there is none
+    int32 GetAgentAt(const FIntPoint& Cell) const;
+
+    int32 GetTeamAgentCount(ETeam Team) const { return TeamAgentCounts[static_cast<int32>(Team)]; }
+
+    int32 GetChunksPerSide() const { return ChunksPerSide; }
+
+    int32 GetTeamChunkCount(ETeam Team, int32 ChunkX, int32 ChunkY) const
+    {
+        return TeamChunkCounts[static_cast<int32>(Team)][ChunkY * ChunksPerSide + ChunkX];
+    }
+
+    // Block coordinates are grid-wide; blocks of chunks never allocated hold nobody
+    int32 GetTeamBlockCount(ETeam Team, int32 BlockX, int32 BlockY) const;
+
+    int32 GetNumAllocatedChunks() const { return NumAllocatedChunks; }
+
+    static constexpr int32 ChunkSize = 64;
+    static constexpr int32 BlockSize = 8;
+    static constexpr int32 BlocksPerChunk = ChunkSize / BlockSize;
 
 private:
-    TMap<FIntPoint, TSet<ABallAgent*>> CellsToAgents;
+    static constexpr int32 ChunkShift = 6;
+    static constexpr int32 ChunkMask = ChunkSize - 1;
+
+    static_assert(ChunkSize == 1 << ChunkShift && ChunkSize == 64, "A chunk line is one uint64 of occupancy bits");
+    static_assert(ChunkSize % BlockSize == 0, "Blocks may not straddle chunks");
+
+    struct FChunk
+    {
+        FChunk();
+
+        // Agent id per cell (LocalY * ChunkSize + LocalX), INDEX_NONE when the cell is empty
+        int32 CellToAgent[ChunkSize * ChunkSize];
+
+        // Bit LocalX of word LocalY is set when that cell holds an agent of the team
+        uint64 TeamOccupancy[NumTeams][ChunkSize];
+
+        // Agents per block and team; a block holds at most BlockSize * BlockSize agents
+        uint8 TeamBlockCounts[NumTeams][BlocksPerChunk * BlocksPerChunk];
+    };
+
+    FORCEINLINE bool IsInGrid(const FIntPoint& Cell) const
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    }
+
+    FORCEINLINE int32 ToChunkIndex(const FIntPoint& Cell) const
+    {
+        return (Cell.Y >> ChunkShift) * ChunksPerSide + (Cell.X >> ChunkShift);
+    }
+
+    static FORCEINLINE int32 ToLocalIndex(const FIntPoint& Cell)
+    {
+        return (Cell.Y & ChunkMask) * ChunkSize + (Cell.X & ChunkMask);
+    }
+
+    static FORCEINLINE int32 ToLocalBlockIndex(const FIntPoint& Cell)
+    {
+        return ((Cell.Y & ChunkMask) / BlockSize) * BlocksPerChunk + (Cell.X & ChunkMask) / BlockSize;
+    }
+
+    // Null for cells outside the grid and for chunks nobody has been registered in yet
+    const FChunk* FindChunk(const FIntPoint& Cell) const
+    {
+        return IsInGrid(Cell) ? Chunks[ToChunkIndex(Cell)].Get() : nullptr;
+    }
+
+    FChunk* FindChunk(const FIntPoint& Cell)
+    {
+        return IsInGrid(Cell) ? Chunks[ToChunkIndex(Cell)].Get() : nullptr;
+    }
+
+    // Cell has to be in the grid
+    FChunk& FindOrAddChunk(const FIntPoint& Cell);
+
+    void PlaceAgent(FChunk& Chunk, int32 AgentId, int32 Team, const FIntPoint& Cell);
+    void ClearCell(FChunk& Chunk, const FIntPoint& Cell);
+
+    TArray<TUniquePtr<FChunk>> Chunks;
+    int32 NumAllocatedChunks = 0;
+
+    // Agents per chunk and team, for every chunk whether allocated or not
+    TArray<int32> TeamChunkCounts[NumTeams];
+    int32 TeamAgentCounts[NumTeams] = {};
+    int32 ChunksPerSide = 0;
+
     int32 GridSize = 0;
 };
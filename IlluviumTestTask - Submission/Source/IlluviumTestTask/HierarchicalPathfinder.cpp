@@ -0,0 +1,646 @@
+#include "HierarchicalPathfinder.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+#include "SimulationStats.h"
+#include "Misc/ScopeLock.h"
+#include "Algo/Reverse.h"
+#include "Algo/Sort.h"
+
+namespace
+{
+    // Border runs at least this long get a transition at each end instead of one in the middle
+    constexpr int32 MinRunForTwoTransitions = 6;
+}
+
+FHierarchicalPathfinder::FHierarchicalPathfinder(int32 InClusterSize, int32 InRefinedSegments)
+    : ClusterSize(FMath::Max(InClusterSize, 2))
+    , RefinedSegments(FMath::Max(InRefinedSegments, 0))
+{
+}
+
+FHierarchicalPathfinder::FQueryScratch& FHierarchicalPathfinder::GetThreadScratch()
+{
+    static thread_local FQueryScratch Scratch;
+    return Scratch;
+}
+
+TArray<FIntPoint> FHierarchicalPathfinder::FindPath(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    if (BuiltGridSize.load(std::memory_order_acquire) != Geometry.GetGridSize() || Shape != Geometry.GetShape())
+    {
+        FScopeLock Lock(&BuildLock);
+        if (BuiltGridSize.load(std::memory_order_relaxed) != Geometry.GetGridSize() || Shape != Geometry.GetShape())
+        {
+            Build(Geometry, Blockers ? Blockers->Layers : nullptr);
+        }
+    }
+
+    switch (Geometry.GetShape())
+    {
+    case EGridShape::Hex:
+        return FindPath<FHexGrid>(Start, Goal, static_cast<const FHexGrid&>(Geometry), PreviousCellBias, Blockers);
+    case EGridShape::Square:
+    default:
+        return FindPath<FSquareGrid>(Start, Goal, static_cast<const FSquareGrid&>(Geometry), PreviousCellBias, Blockers);
+    }
+}
+
+template<typename GeometryType>
+TArray<FIntPoint> FHierarchicalPathfinder::FindPath(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const GeometryType& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers) const
+{
+    if (!IsInGrid(Start) || !IsInGrid(Goal))
+        return {};
+
+    const FPathBlockers OwnStaticObstacles(StaticLayers, false);
+    const FPathBlockers* Blocked = Blockers ? Blockers : &OwnStaticObstacles;
+    FAStarScratch& SearchScratch = AStarPathfinder::GetThreadScratch();
+
+    auto SearchDirect = [&]() -> TArray<FIntPoint>
+    {
+        if (!AStarPathfinder::Search<GeometryType>(Start, Goal, Geometry, PreviousCellBias, Blocked, SearchScratch))
+            return {};
+
+        return AStarPathfinder::ReconstructPath(SearchScratch, GridSize, Goal.Y * GridSize + Goal.X);
+    };
+
+    // Nearby goals are cheaper to search for directly than to route through the abstract graph
+    if (GetClusterOf(Start) == GetClusterOf(Goal) || Geometry.Heuristic(Start, Goal) <= ClusterSize)
+        return SearchDirect();
+
+    FQueryScratch& Scratch = GetThreadScratch();
+    TArray<FIntPoint> Waypoints;
+    if (!SearchAbstract(Start, Goal, Geometry, Scratch, Waypoints))
+    {
+        // Statically cut off, which no amount of low-level searching would change
+        SimulationStats::RecordSearch(0, false, false);
+        return {};
+    }
+
+    const int32 LastWaypoint = Waypoints.Num() - 1;
+    const int32 SegmentsToRefine = RefinedSegments > 0 ? FMath::Min(RefinedSegments, LastWaypoint) : LastWaypoint;
+
+    TArray<FIntPoint> Path;
+    Path.Add(Start);
+
+    // Waypoint the refined path has reached so far
+    int32 Reached = 0;
+
+    for (int32 Segment = 0; Segment < SegmentsToRefine && Reached < LastWaypoint; ++Segment)
+    {
+        const FIntPoint& From = Waypoints[Reached];
+
+        // Agents standing on a transition block it for this query; aim past them at the next waypoint
+        int32 Target = Reached + 1;
+        while (Target < LastWaypoint && Blocked->IsBlocked(Waypoints[Target]))
+        {
+            ++Target;
+        }
+
+        // Each attempt is bounded by the clusters it spans, so a transition cut off by agents costs
+        // a local search before the next waypoint is tried, not a search of the whole grid
+        bool bRefined = false;
+        for (; Target <= LastWaypoint && !bRefined; ++Target)
+        {
+            const int32 MaxExpanded = 4 * (Target - Reached) * ClusterSize * ClusterSize;
+            bRefined = AStarPathfinder::Search<GeometryType>(From, Waypoints[Target], Geometry, Reached == 0 ? PreviousCellBias : nullptr, Blocked, SearchScratch, MaxExpanded);
+        }
+
+        // Nothing ahead can be reached locally; only the full search can still find a way round
+        if (!bRefined)
+            return SearchDirect();
+
+        Reached = Target - 1;
+
+        const FIntPoint& To = Waypoints[Reached];
+        TArray<FIntPoint> SegmentPath = AStarPathfinder::ReconstructPath(SearchScratch, GridSize, To.Y * GridSize + To.X);
+        Path.Append(SegmentPath.GetData() + 1, SegmentPath.Num() - 1);
+    }
+
+    Path.Append(Waypoints.GetData() + Reached + 1, LastWaypoint - Reached);
+    return Path;
+}
+
+template<typename GeometryType>
+bool FHierarchicalPathfinder::SearchAbstract(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const GeometryType& Geometry,
+    FQueryScratch& Scratch,
+    TArray<FIntPoint>& OutWaypoints) const
+{
+    const int32 NumNodes = Nodes.Num();
+    const int32 StartNode = NumNodes;
+    const int32 GoalNode = NumNodes + 1;
+    const int32 GoalCluster = GetClusterOf(Goal);
+
+    LinkToCluster(GetClusterOf(Start), Start, Geometry, Scratch, Scratch.StartEdges);
+    LinkToCluster(GoalCluster, Goal, Geometry, Scratch, Scratch.GoalEdges);
+
+    if (Scratch.StartEdges.IsEmpty() || Scratch.GoalEdges.IsEmpty())
+        return false;
+
+    if (Scratch.Cost.Num() < NumNodes + 2)
+    {
+        Scratch.Cost.SetNumUninitialized(NumNodes + 2);
+        Scratch.CameFrom.SetNumUninitialized(NumNodes + 2);
+        Scratch.VisitedStamp.SetNumZeroed(NumNodes + 2);
+        Scratch.ClosedStamp.SetNumZeroed(NumNodes + 2);
+    }
+
+    if (++Scratch.Generation == 0)
+    {
+        FMemory::Memzero(Scratch.VisitedStamp.GetData(), Scratch.VisitedStamp.Num() * sizeof(uint32));
+        FMemory::Memzero(Scratch.ClosedStamp.GetData(), Scratch.ClosedStamp.Num() * sizeof(uint32));
+        Scratch.Generation = 1;
+    }
+
+    const uint32 Generation = Scratch.Generation;
+    Scratch.Frontier.Reset();
+
+    auto CellOf = [&](int32 Node) -> const FIntPoint&
+    {
+        return Node == StartNode ? Start : Node == GoalNode ? Goal : Nodes[Node].Cell;
+    };
+
+    auto Relax = [&](int32 From, int32 To, float EdgeCost)
+    {
+        if (Scratch.ClosedStamp[To] == Generation)
+            return;
+
+        const float NewCost = Scratch.Cost[From] + EdgeCost;
+        if (Scratch.VisitedStamp[To] != Generation || NewCost < Scratch.Cost[To])
+        {
+            Scratch.VisitedStamp[To] = Generation;
+            Scratch.Cost[To] = NewCost;
+            Scratch.CameFrom[To] = From;
+            Scratch.Frontier.HeapPush(FAStarScratch::FNode{ To, NewCost + Geometry.Heuristic(CellOf(To), Goal) });
+        }
+    };
+
+    Scratch.VisitedStamp[StartNode] = Generation;
+    Scratch.Cost[StartNode] = 0.f;
+    Scratch.CameFrom[StartNode] = StartNode;
+    Scratch.Frontier.HeapPush(FAStarScratch::FNode{ StartNode, 0.f });
+
+    int32 Expanded = 0;
+    bool bFound = false;
+
+    while (!Scratch.Frontier.IsEmpty())
+    {
+        FAStarScratch::FNode Current;
+        Scratch.Frontier.HeapPop(Current, EAllowShrinking::No);
+
+        if (Scratch.ClosedStamp[Current.Index] == Generation)
+            continue;
+
+        Scratch.ClosedStamp[Current.Index] = Generation;
+        ++Expanded;
+
+        if (Current.Index == GoalNode)
+        {
+            bFound = true;
+            break;
+        }
+
+        if (Current.Index == StartNode)
+        {
+            for (const FAbstractEdge& Edge : Scratch.StartEdges)
+            {
+                Relax(StartNode, Edge.To, Edge.Cost);
+            }
+            continue;
+        }
+
+        const FAbstractNode& Node = Nodes[Current.Index];
+        for (const FAbstractEdge& Edge : Node.Edges)
+        {
+            Relax(Current.Index, Edge.To, Edge.Cost);
+        }
+
+        if (Node.Partner != INDEX_NONE)
+        {
+            Relax(Current.Index, Node.Partner, 1.f);
+        }
+
+        if (Node.Cluster == GoalCluster)
+        {
+            for (const FAbstractEdge& Edge : Scratch.GoalEdges)
+            {
+                if (Edge.To == Current.Index)
+                {
+                    Relax(Current.Index, GoalNode, Edge.Cost);
+                    break;
+                }
+            }
+        }
+    }
+
+    SimulationStats::Add(ESimulationCounter::NodesExpanded, Expanded);
+
+    if (!bFound)
+        return false;
+
+    OutWaypoints.Reset();
+    for (int32 Node = GoalNode; ; Node = Scratch.CameFrom[Node])
+    {
+        // Corner cells can carry a node for each of their borders; keep one waypoint per cell
+        if (OutWaypoints.IsEmpty() || OutWaypoints.Last() != CellOf(Node))
+        {
+            OutWaypoints.Add(CellOf(Node));
+        }
+
+        if (Node == StartNode)
+            break;
+    }
+    Algo::Reverse(OutWaypoints);
+
+    return true;
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::ComputeClusterDistances(
+    int32 Cluster,
+    const FIntPoint& Origin,
+    const GeometryType& Geometry,
+    TArray<int32>& OutDistance,
+    TArray<int32>& Queue) const
+{
+    const FIntRect Bounds = GetClusterBounds(Cluster);
+    const int32 Width = Bounds.Width();
+
+    OutDistance.Reset();
+    OutDistance.SetNumUninitialized(Width * Bounds.Height());
+    for (int32& Distance : OutDistance)
+    {
+        Distance = INDEX_NONE;
+    }
+
+    Queue.Reset();
+
+    auto LocalIndex = [&Bounds, Width](const FIntPoint& Cell)
+    {
+        return (Cell.Y - Bounds.Min.Y) * Width + (Cell.X - Bounds.Min.X);
+    };
+
+    if (!IsWalkable(Origin))
+        return;
+
+    OutDistance[LocalIndex(Origin)] = 0;
+    Queue.Add(LocalIndex(Origin));
+
+    for (int32 Head = 0; Head < Queue.Num(); ++Head)
+    {
+        const int32 Local = Queue[Head];
+        const FIntPoint Cell(Bounds.Min.X + Local % Width, Bounds.Min.Y + Local / Width);
+        const int32 NextDistance = OutDistance[Local] + 1;
+
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (Neighbor.X < Bounds.Min.X || Neighbor.X >= Bounds.Max.X || Neighbor.Y < Bounds.Min.Y || Neighbor.Y >= Bounds.Max.Y)
+                return;
+
+            const int32 NeighborLocal = LocalIndex(Neighbor);
+            if (OutDistance[NeighborLocal] != INDEX_NONE || !IsWalkable(Neighbor))
+                return;
+
+            OutDistance[NeighborLocal] = NextDistance;
+            Queue.Add(NeighborLocal);
+        });
+    }
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::LinkToCluster(
+    int32 Cluster,
+    const FIntPoint& Cell,
+    const GeometryType& Geometry,
+    FQueryScratch& Scratch,
+    TArray<FAbstractEdge>& OutEdges) const
+{
+    OutEdges.Reset();
+    ComputeClusterDistances(Cluster, Cell, Geometry, Scratch.Distance, Scratch.Queue);
+
+    const FIntRect Bounds = GetClusterBounds(Cluster);
+    for (int32 NodeId : ClusterNodes[Cluster])
+    {
+        const FIntPoint& NodeCell = Nodes[NodeId].Cell;
+        const int32 Distance = Scratch.Distance[(NodeCell.Y - Bounds.Min.Y) * Bounds.Width() + (NodeCell.X - Bounds.Min.X)];
+        if (Distance != INDEX_NONE)
+        {
+            OutEdges.Add(FAbstractEdge{ NodeId, static_cast<float>(Distance) });
+        }
+    }
+}
+
+void FHierarchicalPathfinder::Build(const IGridGeometry& Geometry, const FGridLayers* StaticObstacles)
+{
+    const int32 NewGridSize = Geometry.GetGridSize();
+
+    // Walkability survives rebuilding the same grid
+    if (NewGridSize != GridSize || StaticObstacles)
+    {
+        GridSize = NewGridSize;
+        StaticLayers.Reset(GridSize);
+    }
+
+    if (StaticObstacles && StaticObstacles->GetGridSize() == GridSize)
+    {
+        for (int32 Y = 0; Y < GridSize; ++Y)
+        {
+            for (int32 X = 0; X < GridSize; ++X)
+            {
+                if (StaticObstacles->IsStaticBlocked(FIntPoint(X, Y)))
+                {
+                    StaticLayers.Set(FGridLayers::ELayer::Static, FIntPoint(X, Y), true);
+                }
+            }
+        }
+    }
+
+    Shape = Geometry.GetShape();
+
+    switch (Shape)
+    {
+    case EGridShape::Hex:
+        BuildGraph(static_cast<const FHexGrid&>(Geometry));
+        break;
+    case EGridShape::Square:
+    default:
+        BuildGraph(static_cast<const FSquareGrid&>(Geometry));
+        break;
+    }
+
+    BuiltGridSize.store(GridSize, std::memory_order_release);
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::BuildGraph(const GeometryType& Geometry)
+{
+    ClustersPerSide = FMath::DivideAndRoundUp(GridSize, ClusterSize);
+    const int32 NumClusters = ClustersPerSide * ClustersPerSide;
+
+    Nodes.Reset();
+    FreeNodes.Reset();
+    ClusterNodes.Reset();
+    ClusterNodes.SetNum(NumClusters);
+    BorderNodes.Reset();
+    BorderNodes.SetNum(NumClusters * Border_Num);
+
+    for (int32 Cluster = 0; Cluster < NumClusters; ++Cluster)
+    {
+        for (int32 Border = 0; Border < Border_Num; ++Border)
+        {
+            BuildBorder(Cluster, static_cast<EBorder>(Border), Geometry);
+        }
+    }
+
+    for (int32 Cluster = 0; Cluster < NumClusters; ++Cluster)
+    {
+        ComputeIntraEdges(Cluster, Geometry);
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("HPA* graph: %d clusters of %d cells, %d abstract nodes"), NumClusters, ClusterSize, GetNumAbstractNodes());
+}
+
+FIntRect FHierarchicalPathfinder::GetClusterBounds(int32 Cluster) const
+{
+    const FIntPoint Min((Cluster % ClustersPerSide) * ClusterSize, (Cluster / ClustersPerSide) * ClusterSize);
+    const FIntPoint Max(FMath::Min(Min.X + ClusterSize, GridSize), FMath::Min(Min.Y + ClusterSize, GridSize));
+    return FIntRect(Min, Max);
+}
+
+int32 FHierarchicalPathfinder::AddNode(const FIntPoint& Cell, int32 Cluster)
+{
+    const int32 NodeId = FreeNodes.IsEmpty() ? Nodes.AddDefaulted() : FreeNodes.Pop(EAllowShrinking::No);
+
+    FAbstractNode& Node = Nodes[NodeId];
+    Node.Cell = Cell;
+    Node.Cluster = Cluster;
+    Node.Partner = INDEX_NONE;
+    Node.Edges.Reset();
+
+    ClusterNodes[Cluster].Add(NodeId);
+    return NodeId;
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::BuildBorder(int32 Cluster, EBorder Border, const GeometryType& Geometry)
+{
+    // Offset of the cluster on the other side, in clusters
+    static constexpr int32 OtherOffsets[Border_Num][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { -1, 1 } };
+
+    const int32 OtherX = Cluster % ClustersPerSide + OtherOffsets[Border][0];
+    const int32 OtherY = Cluster / ClustersPerSide + OtherOffsets[Border][1];
+
+    if (OtherX < 0 || OtherX >= ClustersPerSide || OtherY >= ClustersPerSide)
+        return;
+
+    const FIntRect Bounds = GetClusterBounds(Cluster);
+    const int32 Other = OtherY * ClustersPerSide + OtherX;
+
+    TArray<int32>& BorderList = BorderNodes[Cluster * Border_Num + Border];
+
+    auto AddTransition = [&](const TPair<FIntPoint, FIntPoint>& Crossing)
+    {
+        const int32 Inside = AddNode(Crossing.Key, Cluster);
+        const int32 Outside = AddNode(Crossing.Value, Other);
+        Nodes[Inside].Partner = Outside;
+        Nodes[Outside].Partner = Inside;
+        BorderList.Add(Inside);
+        BorderList.Add(Outside);
+    };
+
+    // Every pair of walkable neighbours across the border, in order along it. A hex cell may cross to
+    // up to three cells, which need not be connected on the other side, so each pair counts on its own.
+    TArray<TPair<FIntPoint, FIntPoint>, TInlineAllocator<64>> Crossings;
+
+    auto AddCrossings = [&](const FIntPoint& Cell)
+    {
+        if (!IsWalkable(Cell))
+            return;
+
+        const int32 FirstCrossing = Crossings.Num();
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (IsInGrid(Neighbor) && GetClusterOf(Neighbor) == Other && IsWalkable(Neighbor))
+            {
+                Crossings.Emplace(Cell, Neighbor);
+            }
+        });
+
+        const bool bAlongY = Border == Border_East;
+        Algo::SortBy(MakeArrayView(Crossings.GetData() + FirstCrossing, Crossings.Num() - FirstCrossing),
+            [bAlongY](const TPair<FIntPoint, FIntPoint>& Crossing) { return bAlongY ? Crossing.Value.Y : Crossing.Value.X; });
+    };
+
+    if (Border == Border_SouthEast || Border == Border_SouthWest)
+    {
+        AddCrossings(FIntPoint(Border == Border_SouthEast ? Bounds.Max.X - 1 : Bounds.Min.X, Bounds.Max.Y - 1));
+    }
+    else if (Border == Border_East)
+    {
+        for (int32 Y = Bounds.Min.Y; Y < Bounds.Max.Y; ++Y)
+        {
+            AddCrossings(FIntPoint(Bounds.Max.X - 1, Y));
+        }
+    }
+    else
+    {
+        for (int32 X = Bounds.Min.X; X < Bounds.Max.X; ++X)
+        {
+            AddCrossings(FIntPoint(X, Bounds.Max.Y - 1));
+        }
+    }
+
+    auto AreLinked = [&Geometry](const FIntPoint& A, const FIntPoint& B)
+    {
+        bool bLinked = A == B;
+        Geometry.ForEachNeighbor(A, [&](const FIntPoint& Neighbor)
+        {
+            bLinked |= Neighbor == B;
+        });
+        return bLinked;
+    };
+
+    // A run of crossings connected to each other on both sides is served by one transition (two at its ends when long)
+    for (int32 i = 0; i < Crossings.Num(); )
+    {
+        const int32 RunStart = i++;
+        while (i < Crossings.Num() && AreLinked(Crossings[i - 1].Key, Crossings[i].Key) && AreLinked(Crossings[i - 1].Value, Crossings[i].Value))
+        {
+            ++i;
+        }
+        const int32 RunEnd = i - 1;
+
+        if (RunEnd - RunStart + 1 >= MinRunForTwoTransitions)
+        {
+            AddTransition(Crossings[RunStart]);
+            AddTransition(Crossings[RunEnd]);
+        }
+        else
+        {
+            AddTransition(Crossings[(RunStart + RunEnd) / 2]);
+        }
+    }
+}
+
+void FHierarchicalPathfinder::ClearBorder(int32 Cluster, EBorder Border)
+{
+    TArray<int32>& BorderList = BorderNodes[Cluster * Border_Num + Border];
+    for (int32 NodeId : BorderList)
+    {
+        FAbstractNode& Node = Nodes[NodeId];
+        ClusterNodes[Node.Cluster].RemoveSingle(NodeId);
+        Node.Cluster = INDEX_NONE;
+        Node.Partner = INDEX_NONE;
+        Node.Edges.Reset();
+        FreeNodes.Add(NodeId);
+    }
+    BorderList.Reset();
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::ComputeIntraEdges(int32 Cluster, const GeometryType& Geometry)
+{
+    TArray<int32> Distance;
+    TArray<int32> Queue;
+    const FIntRect Bounds = GetClusterBounds(Cluster);
+
+    for (int32 NodeId : ClusterNodes[Cluster])
+    {
+        FAbstractNode& Node = Nodes[NodeId];
+        Node.Edges.Reset();
+
+        ComputeClusterDistances(Cluster, Node.Cell, Geometry, Distance, Queue);
+
+        for (int32 OtherId : ClusterNodes[Cluster])
+        {
+            if (OtherId == NodeId)
+                continue;
+
+            const FIntPoint& OtherCell = Nodes[OtherId].Cell;
+            const int32 OtherDistance = Distance[(OtherCell.Y - Bounds.Min.Y) * Bounds.Width() + (OtherCell.X - Bounds.Min.X)];
+            if (OtherDistance != INDEX_NONE)
+            {
+                Node.Edges.Add(FAbstractEdge{ OtherId, static_cast<float>(OtherDistance) });
+            }
+        }
+    }
+}
+
+void FHierarchicalPathfinder::SetCellWalkable(const FIntPoint& Cell, bool bWalkable)
+{
+    if (BuiltGridSize.load(std::memory_order_relaxed) == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("HPA* walkability changed before Build(); ignoring %s"), *Cell.ToString());
+        return;
+    }
+
+    if (Cell.X < 0 || Cell.X >= GridSize || Cell.Y < 0 || Cell.Y >= GridSize || IsWalkable(Cell) == bWalkable)
+        return;
+
+    StaticLayers.Set(FGridLayers::ELayer::Static, Cell, !bWalkable);
+
+    const int32 Cluster = GetClusterOf(Cell);
+    if (Shape == EGridShape::Hex)
+    {
+        RepairAround(Cluster, FHexGrid(GridSize, 1.f));
+    }
+    else
+    {
+        RepairAround(Cluster, FSquareGrid(GridSize, 1.f));
+    }
+}
+
+template<typename GeometryType>
+void FHierarchicalPathfinder::RepairAround(int32 Cluster, const GeometryType& Geometry)
+{
+    const int32 ClusterX = Cluster % ClustersPerSide;
+    const int32 ClusterY = Cluster / ClustersPerSide;
+
+    // Transitions of the cluster may end in any of its eight neighbours
+    TArray<int32, TInlineAllocator<9>> Affected;
+    for (int32 Y = FMath::Max(ClusterY - 1, 0); Y <= FMath::Min(ClusterY + 1, ClustersPerSide - 1); ++Y)
+    {
+        for (int32 X = FMath::Max(ClusterX - 1, 0); X <= FMath::Min(ClusterX + 1, ClustersPerSide - 1); ++X)
+        {
+            Affected.Add(Y * ClustersPerSide + X);
+        }
+    }
+
+    // Every border and corner of the cluster: its own, and those its west and north neighbours have with it
+    TArray<TPair<int32, EBorder>, TInlineAllocator<8>> Borders;
+    Borders.Emplace(Cluster, Border_East);
+    Borders.Emplace(Cluster, Border_South);
+    Borders.Emplace(Cluster, Border_SouthEast);
+    Borders.Emplace(Cluster, Border_SouthWest);
+    if (ClusterX > 0) Borders.Emplace(Cluster - 1, Border_East);
+    if (ClusterY > 0) Borders.Emplace(Cluster - ClustersPerSide, Border_South);
+    if (ClusterX > 0 && ClusterY > 0) Borders.Emplace(Cluster - ClustersPerSide - 1, Border_SouthEast);
+    if (ClusterX + 1 < ClustersPerSide && ClusterY > 0) Borders.Emplace(Cluster - ClustersPerSide + 1, Border_SouthWest);
+
+    for (const TPair<int32, EBorder>& Border : Borders)
+    {
+        ClearBorder(Border.Key, Border.Value);
+    }
+
+    for (const TPair<int32, EBorder>& Border : Borders)
+    {
+        BuildBorder(Border.Key, Border.Value, Geometry);
+    }
+
+    for (int32 AffectedCluster : Affected)
+    {
+        ComputeIntraEdges(AffectedCluster, Geometry);
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathfinder.h"
+#include "AStarPathfinder.h"
+#include <atomic>
+
+/*
+====================================================================================
+  FHierarchicalPathfinder - HPA* over fixed-size clusters
+====================================================================================
+
+- Splits the grid into ClusterSize x ClusterSize clusters. Along every border between
+  two clusters, each run of walkable neighbour pairs across it gets one transition
+  (two at its ends for runs of 6 or more), i.e. one abstract node on each side, linked
+  with cost 1. On hex grids a pair may cross diagonally, one row up or down, and where
+  four clusters meet a corner cell can cross into the diagonal cluster, which gets a
+  transition of its own.
+- Nodes of the same cluster are linked by their in-cluster distances, found with a
+  breadth-first search limited to the cluster. This abstract graph only depends on
+  static walkability (SetCellWalkable()), never on agents.
+- A query links start and goal into their clusters, searches the abstract graph and
+  then refines only the first RefinedSegments segments with AStarPathfinder, which is
+  where the query's blockers and PreviousCellBias apply.
+- Changing a cell's walkability rebuilds the borders and corners of its cluster and the
+  in-cluster links of that cluster and its eight neighbours, nothing else.
+
+Notes:
+- Only the refined part of the returned path is made of adjacent cells; it continues
+  with the remaining abstract waypoints. Path[1] is always a real step. Set
+  RefinedSegments to 0 for fully refined paths.
+- Queries within one cluster fall back to a plain A* search. A refined segment whose
+  transition is blocked by agents heads for the next waypoint instead, each attempt
+  bounded by the clusters it spans; only when no waypoint ahead can be reached does
+  the query fall back to a full A* search.
+- The low-level searches take static obstacles from the layers a query passes in, so
+  the abstract graph has to be built from the same static layer, and SetCellWalkable()
+  only mirrors a change made to it. Queries without blockers use the graph's own copy.
+- Queries may run on several threads at once; SetCellWalkable() must not overlap them.
+*/
+
+class FHierarchicalPathfinder final : public IPathfinder
+{
+public:
+    explicit FHierarchicalPathfinder(int32 InClusterSize = 16, int32 InRefinedSegments = 1);
+
+    virtual TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr) override;
+
+    virtual bool SupportsConcurrentQueries() const override { return true; }
+
+    // Blocks or frees Cell in the abstract graph and repairs it around the cell; the static
+    // layer later queries pass in has to change the same way
+    void SetCellWalkable(const FIntPoint& Cell, bool bWalkable);
+
+    // Builds the clusters and the abstract graph for Geometry. FindPath() does this on its
+    // first call for a grid, from the layers it is given, so calling it up front only moves
+    // the cost. The static layer of StaticObstacles replaces every earlier SetCellWalkable(),
+    // and is far cheaper than blocking cells one by one.
+    void Build(const IGridGeometry& Geometry, const FGridLayers* StaticObstacles = nullptr);
+
+    int32 GetNumAbstractNodes() const { return Nodes.Num() - FreeNodes.Num(); }
+
+    int32 GetClusterSize() const { return ClusterSize; }
+
+private:
+    struct FAbstractEdge
+    {
+        int32 To;
+        float Cost;
+    };
+
+    struct FAbstractNode
+    {
+        FIntPoint Cell;
+        int32 Cluster = INDEX_NONE;
+
+        // Node on the other side of the border
+        int32 Partner = INDEX_NONE;
+
+        // Nodes of the same cluster this one can reach
+        TArray<FAbstractEdge> Edges;
+    };
+
+    // Per-thread state of one query
+    struct FQueryScratch
+    {
+        TArray<float> Cost;
+        TArray<int32> CameFrom;
+        TArray<uint32> VisitedStamp;
+        TArray<uint32> ClosedStamp;
+        uint32 Generation = 0;
+        TArray<FAStarScratch::FNode> Frontier;
+
+        TArray<FAbstractEdge> StartEdges;
+        TArray<FAbstractEdge> GoalEdges;
+
+        // Breadth-first search inside one cluster
+        TArray<int32> Distance;
+        TArray<int32> Queue;
+    };
+
+    static FQueryScratch& GetThreadScratch();
+
+    template<typename GeometryType>
+    TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const GeometryType& Geometry,
+        const FIntPoint* PreviousCellBias,
+        const FPathBlockers* Blockers) const;
+
+    // Abstract search from Start to Goal; fills OutWaypoints with the cells along the way
+    template<typename GeometryType>
+    bool SearchAbstract(const FIntPoint& Start, const FIntPoint& Goal, const GeometryType& Geometry, FQueryScratch& Scratch, TArray<FIntPoint>& OutWaypoints) const;
+
+    // Distances from Origin to every cell of Cluster, by breadth-first search that stays inside it
+    template<typename GeometryType>
+    void ComputeClusterDistances(int32 Cluster, const FIntPoint& Origin, const GeometryType& Geometry, TArray<int32>& OutDistance, TArray<int32>& Queue) const;
+
+    // Links from Cell to every node of Cluster it can reach
+    template<typename GeometryType>
+    void LinkToCluster(int32 Cluster, const FIntPoint& Cell, const GeometryType& Geometry, FQueryScratch& Scratch, TArray<FAbstractEdge>& OutEdges) const;
+
+    template<typename GeometryType>
+    void BuildGraph(const GeometryType& Geometry);
+
+    template<typename GeometryType>
+    void ComputeIntraEdges(int32 Cluster, const GeometryType& Geometry);
+
+    template<typename GeometryType>
+    void RepairAround(int32 Cluster, const GeometryType& Geometry);
+
+    // What a cluster borders on, towards higher cluster ids; every other border is one of these seen
+    // from the other cluster. The diagonal ones are single corner cells, only ever crossed on hex grids.
+    enum EBorder : int32
+    {
+        Border_East,
+        Border_South,
+        Border_SouthEast,
+        Border_SouthWest,
+        Border_Num
+    };
+
+    template<typename GeometryType>
+    void BuildBorder(int32 Cluster, EBorder Border, const GeometryType& Geometry);
+    void ClearBorder(int32 Cluster, EBorder Border);
+
+    int32 AddNode(const FIntPoint& Cell, int32 Cluster);
+
+    int32 GetClusterOf(const FIntPoint& Cell) const
+    {
+        return (Cell.X / ClusterSize) + (Cell.Y / ClusterSize) * ClustersPerSide;
+    }
+
+    FIntRect GetClusterBounds(int32 Cluster) const;
+
+    bool IsInGrid(const FIntPoint& Cell) const
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    }
+
+    bool IsWalkable(const FIntPoint& Cell) const
+    {
+        return !StaticLayers.IsStaticBlocked(Cell);
+    }
+
+    int32 ClusterSize;
+    int32 RefinedSegments;
+
+    int32 GridSize = 0;
+    int32 ClustersPerSide = 0;
+    EGridShape Shape = EGridShape::Square;
+
+    // Only the static layer is used
+    FGridLayers StaticLayers;
+
+    TArray<FAbstractNode> Nodes;
+    TArray<int32> FreeNodes;
+
+    // Node ids per cluster, and per cluster border (Cluster * Border_Num + Border)
+    TArray<TArray<int32>> ClusterNodes;
+    TArray<TArray<int32>> BorderNodes;
+
+    // Grid size the graph was built for, 0 before the first build
+    std::atomic<int32> BuiltGridSize = 0;
+    FCriticalSection BuildLock;
+};
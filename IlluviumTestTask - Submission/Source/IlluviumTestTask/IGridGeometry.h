@@ -2,18 +2,43 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "StepArena.h"
 
+// Most neighbours any geometry has (hex)
+constexpr int32 MaxGridNeighbors = 6;
+
+// Neighbour list stored inline, so asking for neighbours never allocates
+using FGridNeighbors = TArray<FIntPoint, TFixedAllocator<MaxGridNeighbors>>;
+
+// Concrete geometry behind an IGridGeometry, used to pick a specialised code path once
+enum class EGridShape : uint8
+{
+    Square,
+    Hex
+};
+
+// The virtual interface is meant for set-up and occasional queries. Hot loops (A*, flow fields) are
+// instantiated per concrete geometry instead and call its inline ForEachNeighbor() / Heuristic().
 class IGridGeometry
 {
 public:
     virtual ~IGridGeometry() = default;
 
+    virtual EGridShape GetShape() const = 0;
+
     // Returns all neighboring cells based on the grid type
-    virtual TArray<FIntPoint> GetNeighbors(const FIntPoint& Cell) const = 0;
+    virtual FGridNeighbors GetNeighbors(const FIntPoint& Cell) const = 0;
 
     virtual FVector GetTileWorldPosition(const FIntPoint& Cell, const FVector& GridOrigin) const = 0;
 
-    virtual TArray<FIntPoint> GetCellsInRange(const FIntPoint& Center, int32 Range) const = 0;
+    // Appends the cells at most Range steps away from Center; the caller owns the arena scope
+    virtual void GetCellsInRange(const FIntPoint& Center, int32 Range, TStepArray<FIntPoint>& OutCells) const = 0;
+
+    // Appends the cells exactly Ring steps away from Center, in the order GetCellsInRange visits them
+    virtual void GetCellsInRing(const FIntPoint& Center, int32 Ring, TStepArray<FIntPoint>& OutCells) const = 0;
+
+    // Smallest possible number of steps between two cells whose coordinates differ by Delta
+    virtual int32 GetDistanceLowerBound(const FIntPoint& Delta) const = 0;
 
     // Converts world location to grid coordinate
     virtual FIntPoint WorldToGrid(const FVector& WorldLocation) const = 0;
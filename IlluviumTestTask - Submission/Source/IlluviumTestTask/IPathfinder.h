@@ -3,6 +3,7 @@
 
 #include "CoreMinimal.h"
 #include "IGridGeometry.h"
+#include "GridLayers.h"
 #include <queue>
 #include <set>
 #include <map>
@@ -17,6 +18,28 @@ public:
         const FIntPoint& Goal,
         const IGridGeometry& Geometry,
         const FIntPoint* PreviousCellBias = nullptr,
-        const TSet<FIntPoint>* TempUnwalkable = nullptr
+        const FPathBlockers* Blockers = nullptr
     ) = 0;
+
+    // FindPath() on behalf of one agent, for pathfinders that keep search state per agent between
+    // queries. AgentId stays the same for the agent's whole life; ForgetAgent() is called once it dies.
+    virtual TArray<FIntPoint> FindAgentPath(
+        int32 AgentId,
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr)
+    {
+        return FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    virtual void ForgetAgent(int32 AgentId) {}
+
+    // Called by the grid manager whenever an agent enters or leaves Cell, so pathfinders that keep
+    // results between queries can drop the ones crossing it
+    virtual void OnCellOccupancyChanged(const FIntPoint& Cell) {}
+
+    // Whether FindPath may be called from several threads at once
+    virtual bool SupportsConcurrentQueries() const { return false; }
 };
\ No newline at end of file
@@ -1,7 +1,19 @@
 #include "IlluviumTestTask.h"
 #include "Modules/ModuleManager.h"
+#include "SimulationBenchmarks.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, IlluviumTestTask, "IlluviumTestTask" );
+class FIlluviumTestTaskModule : public FDefaultGameModuleImpl
+{
+public:
+    virtual void StartupModule() override
+    {
+#if !UE_BUILD_SHIPPING
+        SimulationBenchmarks::InstallAllocationCounter();
+#endif
+    }
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FIlluviumTestTaskModule, IlluviumTestTask, "IlluviumTestTask" );
 
 DEFINE_LOG_CATEGORY(LogIlluviumTestTask)
  
\ No newline at end of file
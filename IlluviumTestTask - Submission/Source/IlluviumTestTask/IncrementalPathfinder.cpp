@@ -0,0 +1,452 @@
+#include "IncrementalPathfinder.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+#include "SimulationStats.h"
+#include "Misc/ScopeLock.h"
+
+FIncrementalPathfinder::FIncrementalPathfinder(int32 InMaxNodesPerAgent)
+    : MaxNodesPerAgent(FMath::Max(InMaxNodesPerAgent, 64))
+{
+}
+
+TArray<FIntPoint> FIncrementalPathfinder::FindPath(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+}
+
+TArray<FIntPoint> FIncrementalPathfinder::FindAgentPath(
+    int32 AgentId,
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    if (AgentId == INDEX_NONE)
+    {
+        return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    FAgentSearch& Search = GetAgentSearch(AgentId);
+
+    switch (Geometry.GetShape())
+    {
+    case EGridShape::Hex:
+        return FindAgentPath(Search, Start, Goal, static_cast<const FHexGrid&>(Geometry), PreviousCellBias, Blockers);
+    case EGridShape::Square:
+    default:
+        return FindAgentPath(Search, Start, Goal, static_cast<const FSquareGrid&>(Geometry), PreviousCellBias, Blockers);
+    }
+}
+
+void FIncrementalPathfinder::ForgetAgent(int32 AgentId)
+{
+    FScopeLock Lock(&AgentSearchesLock);
+
+    if (AgentSearches.IsValidIndex(AgentId))
+    {
+        AgentSearches[AgentId].Reset();
+    }
+}
+
+void FIncrementalPathfinder::OnCellOccupancyChanged(const FIntPoint& Cell)
+{
+    if (ChangeLog.Num() >= MaxChangeLogEntries)
+    {
+        const int32 NumDropped = ChangeLog.Num() / 2;
+        ChangeLog.RemoveAt(0, NumDropped, EAllowShrinking::No);
+        ChangeLogBase += NumDropped;
+    }
+
+    ChangeLog.Add(Cell);
+}
+
+void FIncrementalPathfinder::Reset()
+{
+    FScopeLock Lock(&AgentSearchesLock);
+
+    AgentSearches.Reset();
+    ChangeLog.Reset();
+    ChangeLogBase = 0;
+}
+
+FIncrementalPathfinder::FAgentSearch& FIncrementalPathfinder::GetAgentSearch(int32 AgentId)
+{
+    // Only the slot lookup is shared; each search belongs to one agent, which queries from one thread
+    FScopeLock Lock(&AgentSearchesLock);
+
+    if (AgentId >= AgentSearches.Num())
+    {
+        AgentSearches.SetNum(AgentId + 1);
+    }
+
+    TUniquePtr<FAgentSearch>& Slot = AgentSearches[AgentId];
+    if (!Slot)
+    {
+        Slot = MakeUnique<FAgentSearch>();
+    }
+
+    return *Slot;
+}
+
+template<typename GeometryType>
+TArray<FIntPoint> FIncrementalPathfinder::FindAgentPath(
+    FAgentSearch& Search,
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const GeometryType& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    SIMULATION_SCOPE(FindPath);
+
+    const int32 GridSize = Geometry.GetGridSize();
+
+    auto IsInGrid = [GridSize](const FIntPoint& Cell)
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    };
+
+    if (!IsInGrid(Start) || !IsInGrid(Goal))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("D* Lite could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
+        SimulationStats::RecordSearch(0, false, false);
+        return {};
+    }
+
+    const int64 ChangeLogEnd = ChangeLogBase + ChangeLog.Num();
+
+    const bool bCanRepair = Search.GridSize == GridSize
+        && !Search.Nodes.IsEmpty()
+        && Search.ChangesSeen >= ChangeLogBase
+        && Search.Goal == Goal;
+
+    if (!bCanRepair)
+    {
+        Restart(Search, Start, Goal, Geometry, Blockers);
+    }
+    else
+    {
+        const FIntPoint OldStart = Search.Start;
+
+        if (Start != OldStart)
+        {
+            Search.KeyModifier += static_cast<int32>(Geometry.Heuristic(OldStart, Start));
+            Search.Start = Start;
+        }
+
+        for (int64 Change = Search.ChangesSeen; Change < ChangeLogEnd; ++Change)
+        {
+            const FIntPoint& Cell = ChangeLog[static_cast<int32>(Change - ChangeLogBase)];
+            if (Cell.X >= Search.BoundsMin.X && Cell.X <= Search.BoundsMax.X && Cell.Y >= Search.BoundsMin.Y && Cell.Y <= Search.BoundsMax.Y)
+            {
+                RefreshCell(Search, Cell, Geometry, Blockers);
+            }
+        }
+
+        // Callers ignore the occupants of the start and goal, so these change without any log entry
+        for (const FIntPoint& Cell : { OldStart, Start, Goal })
+        {
+            RefreshCell(Search, Cell, Geometry, Blockers);
+        }
+    }
+
+    Search.ChangesSeen = ChangeLogEnd;
+
+    int32 Expanded = 0;
+    if (!ComputeShortestPath(Search, Geometry, Blockers, Expanded))
+    {
+        SimulationStats::RecordSearch(Expanded, false, true);
+
+        Search.Nodes.Empty();
+        Search.Queue.Empty();
+        Search.GridSize = 0;
+        return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    const FNodeState* StartNode = Search.Nodes.Find(Start.Y * GridSize + Start.X);
+    if (!StartNode || StartNode->G >= Unreachable)
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("D* Lite could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
+        SimulationStats::RecordSearch(Expanded, false, false);
+        return {};
+    }
+
+    SimulationStats::RecordSearch(Expanded, true, false);
+
+    // Every cell on a shortest route is consistent here, so following the costs down is exact
+    auto FindNextCell = [&](const FIntPoint& Cell, int32 Remaining, const FIntPoint* Avoid, FIntPoint& OutNext)
+    {
+        bool bFound = false;
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (bFound || !IsInGrid(Neighbor) || (Avoid && Neighbor == *Avoid))
+                return;
+
+            const FNodeState* Node = Search.Nodes.Find(Neighbor.Y * GridSize + Neighbor.X);
+            if (Node && !Node->bBlocked && Node->G == Remaining - 1)
+            {
+                OutNext = Neighbor;
+                bFound = true;
+            }
+        });
+        return bFound;
+    };
+
+    int32 Remaining = StartNode->G;
+
+    TArray<FIntPoint> Path;
+    Path.Reserve(Remaining + 1);
+    Path.Add(Start);
+
+    FIntPoint Cell = Start;
+    while (Cell != Goal)
+    {
+        FIntPoint Next;
+        const FIntPoint* Avoid = Path.Num() == 1 ? PreviousCellBias : nullptr;
+        if (!FindNextCell(Cell, Remaining, Avoid, Next))
+        {
+            // Only stepping back is shortest; A* decides how far a detour is worth it
+            return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+        }
+
+        Path.Add(Next);
+        Cell = Next;
+        --Remaining;
+    }
+
+    return Path;
+}
+
+template<typename GeometryType>
+void FIncrementalPathfinder::Restart(
+    FAgentSearch& Search,
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const GeometryType& Geometry,
+    const FPathBlockers* Blockers) const
+{
+    Search.GridSize = Geometry.GetGridSize();
+    Search.Start = Start;
+    Search.Goal = Goal;
+    Search.KeyModifier = 0;
+    Search.BoundsMin = Goal;
+    Search.BoundsMax = Goal;
+    Search.Nodes.Reset();
+    Search.Queue.Reset();
+
+    const int32 GoalIndex = Goal.Y * Search.GridSize + Goal.X;
+    FNodeState& GoalNode = Search.Nodes.Add(GoalIndex);
+    GoalNode.Rhs = 0;
+    GoalNode.bBlocked = Blockers && Blockers->IsBlocked(Goal);
+    GoalNode.bQueued = true;
+    CalculateKey(Search, Goal, GoalNode, Geometry, GoalNode.Key1, GoalNode.Key2);
+
+    Search.Queue.HeapPush(FQueueEntry{ GoalNode.Key1, GoalNode.Key2, GoalIndex });
+}
+
+template<typename GeometryType>
+void FIncrementalPathfinder::RefreshCell(
+    FAgentSearch& Search,
+    const FIntPoint& Cell,
+    const GeometryType& Geometry,
+    const FPathBlockers* Blockers) const
+{
+    const int32 GridSize = Search.GridSize;
+
+    FNodeState* Node = Search.Nodes.Find(Cell.Y * GridSize + Cell.X);
+    if (!Node)
+        return;
+
+    const bool bBlocked = Blockers && Blockers->IsBlocked(Cell);
+    if (Node->bBlocked == bBlocked)
+        return;
+
+    Node->bBlocked = bBlocked;
+
+    // Every neighbour may step into Cell, including ones never stored because Cell used to be blocked
+    Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+    {
+        if (Neighbor.X >= 0 && Neighbor.X < GridSize && Neighbor.Y >= 0 && Neighbor.Y < GridSize)
+        {
+            UpdateVertex(Search, Neighbor, Geometry, Blockers);
+        }
+    });
+}
+
+template<typename GeometryType>
+void FIncrementalPathfinder::UpdateVertex(
+    FAgentSearch& Search,
+    const FIntPoint& Cell,
+    const GeometryType& Geometry,
+    const FPathBlockers* Blockers) const
+{
+    const int32 GridSize = Search.GridSize;
+    const int32 Index = Cell.Y * GridSize + Cell.X;
+
+    int32 Rhs = 0;
+    if (Cell != Search.Goal)
+    {
+        Rhs = Unreachable;
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (Neighbor.X < 0 || Neighbor.X >= GridSize || Neighbor.Y < 0 || Neighbor.Y >= GridSize)
+                return;
+
+            const FNodeState* NeighborNode = Search.Nodes.Find(Neighbor.Y * GridSize + Neighbor.X);
+            if (NeighborNode && !NeighborNode->bBlocked && NeighborNode->G < Unreachable)
+            {
+                Rhs = FMath::Min(Rhs, NeighborNode->G + 1);
+            }
+        });
+    }
+
+    FNodeState* Node = Search.Nodes.Find(Index);
+    if (!Node)
+    {
+        // A cell nothing leads from is consistent without being stored
+        if (Rhs >= Unreachable)
+            return;
+
+        Node = &Search.Nodes.Add(Index);
+        Node->bBlocked = Blockers && Blockers->IsBlocked(Cell);
+
+        Search.BoundsMin = Search.BoundsMin.ComponentMin(Cell);
+        Search.BoundsMax = Search.BoundsMax.ComponentMax(Cell);
+    }
+
+    Node->Rhs = Rhs;
+
+    if (Node->G != Node->Rhs)
+    {
+        CalculateKey(Search, Cell, *Node, Geometry, Node->Key1, Node->Key2);
+        Node->bQueued = true;
+        Search.Queue.HeapPush(FQueueEntry{ Node->Key1, Node->Key2, Index });
+    }
+    else
+    {
+        Node->bQueued = false;
+    }
+}
+
+template<typename GeometryType>
+bool FIncrementalPathfinder::ComputeShortestPath(
+    FAgentSearch& Search,
+    const GeometryType& Geometry,
+    const FPathBlockers* Blockers,
+    int32& OutExpanded) const
+{
+    const int32 GridSize = Search.GridSize;
+    const int32 StartIndex = Search.Start.Y * GridSize + Search.Start.X;
+
+    // Entries are never removed in place; a node's live entry is the one matching its stored key
+    auto IsLive = [&Search](const FQueueEntry& Entry)
+    {
+        const FNodeState* Node = Search.Nodes.Find(Entry.Index);
+        return Node && Node->bQueued && Node->Key1 == Entry.Key1 && Node->Key2 == Entry.Key2;
+    };
+
+    auto ForEachInGridNeighbor = [&](const FIntPoint& Cell, auto&& Func)
+    {
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (Neighbor.X >= 0 && Neighbor.X < GridSize && Neighbor.Y >= 0 && Neighbor.Y < GridSize)
+            {
+                Func(Neighbor);
+            }
+        });
+    };
+
+    while (true)
+    {
+        while (!Search.Queue.IsEmpty() && !IsLive(Search.Queue.HeapTop()))
+        {
+            Search.Queue.HeapPopDiscard(EAllowShrinking::No);
+        }
+
+        if (Search.Queue.IsEmpty())
+            break;
+
+        const FQueueEntry Top = Search.Queue.HeapTop();
+
+        const FNodeState* StartNode = Search.Nodes.Find(StartIndex);
+        const FNodeState StartState = StartNode ? *StartNode : FNodeState();
+
+        int32 StartKey1, StartKey2;
+        CalculateKey(Search, Search.Start, StartState, Geometry, StartKey1, StartKey2);
+
+        const bool bTopBeforeStart = Top.Key1 < StartKey1 || (Top.Key1 == StartKey1 && Top.Key2 < StartKey2);
+        if (!bTopBeforeStart && StartState.Rhs == StartState.G)
+            break;
+
+        if (Search.Nodes.Num() > MaxNodesPerAgent)
+            return false;
+
+        Search.Queue.HeapPopDiscard(EAllowShrinking::No);
+        ++OutExpanded;
+
+        const FIntPoint Cell(Top.Index % GridSize, Top.Index / GridSize);
+
+        // UpdateVertex() may add nodes and move this one, so the reference is only used up to there
+        FNodeState& Node = Search.Nodes[Top.Index];
+
+        int32 NewKey1, NewKey2;
+        CalculateKey(Search, Cell, Node, Geometry, NewKey1, NewKey2);
+
+        if (Top.Key1 < NewKey1 || (Top.Key1 == NewKey1 && Top.Key2 < NewKey2))
+        {
+            // Queued before the start moved; the key only grew, so it goes back in
+            Node.Key1 = NewKey1;
+            Node.Key2 = NewKey2;
+            Search.Queue.HeapPush(FQueueEntry{ NewKey1, NewKey2, Top.Index });
+        }
+        else if (Node.G > Node.Rhs)
+        {
+            Node.G = Node.Rhs;
+            Node.bQueued = false;
+
+            ForEachInGridNeighbor(Cell, [&](const FIntPoint& Neighbor)
+            {
+                UpdateVertex(Search, Neighbor, Geometry, Blockers);
+            });
+        }
+        else
+        {
+            Node.G = Unreachable;
+            UpdateVertex(Search, Cell, Geometry, Blockers);
+
+            ForEachInGridNeighbor(Cell, [&](const FIntPoint& Neighbor)
+            {
+                UpdateVertex(Search, Neighbor, Geometry, Blockers);
+            });
+        }
+    }
+
+    // Stale entries pile up over many repairs; drop them once they outnumber the nodes
+    if (Search.Queue.Num() > 2 * Search.Nodes.Num() + 64)
+    {
+        Search.Queue.RemoveAllSwap([&IsLive](const FQueueEntry& Entry) { return !IsLive(Entry); }, EAllowShrinking::No);
+        Search.Queue.Heapify();
+    }
+
+    return true;
+}
+
+template<typename GeometryType>
+void FIncrementalPathfinder::CalculateKey(
+    const FAgentSearch& Search,
+    const FIntPoint& Cell,
+    const FNodeState& Node,
+    const GeometryType& Geometry,
+    int32& OutKey1,
+    int32& OutKey2) const
+{
+    const int32 Cost = FMath::Min(Node.G, Node.Rhs);
+    OutKey1 = Cost + static_cast<int32>(Geometry.Heuristic(Search.Start, Cell)) + Search.KeyModifier;
+    OutKey2 = Cost;
+}
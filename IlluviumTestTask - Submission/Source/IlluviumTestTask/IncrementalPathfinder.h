@@ -0,0 +1,155 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathfinder.h"
+#include "AStarPathfinder.h"
+
+/*
+====================================================================================
+  FIncrementalPathfinder - D* Lite search state kept per agent
+====================================================================================
+
+- Every agent asking through FindAgentPath() owns a D* Lite search rooted at its
+  target, so the agent moving between queries only shifts the key modifier and the
+  search carries on.
+- A target that moves starts the search over, as in D* Lite: every stored cost is a
+  distance to the old target, so keeping them would not bound the repair.
+- Occupancy changes reported through OnCellOccupancyChanged() go to a change log. On
+  its next query an agent replays the entries it has not seen yet, and only the
+  cells its search has touched (and whose blocked state really changed) are repaired.
+  The work per query follows the number of changes, not the grid size.
+- Queue order is the D* Lite key, then the cell index, and the returned path takes
+  the first neighbour (in ForEachNeighbor() order) on a shortest route. The path
+  therefore does not depend on the history of earlier repairs, only on the grid.
+
+Notes:
+- A search touching more than MaxNodesPerAgent cells is dropped and the query is
+  answered by AStarPathfinder instead; each touched cell costs roughly 40 bytes.
+- PreviousCellBias only steers the first step. When stepping back is the only
+  shortest way, the query goes to AStarPathfinder so detours match its penalty.
+- FindPath() has no agent to keep state for and always uses AStarPathfinder.
+- Queries for different agents may run concurrently; OnCellOccupancyChanged() and
+  ForgetAgent() must not overlap them.
+*/
+
+class FIncrementalPathfinder final : public IPathfinder
+{
+public:
+    explicit FIncrementalPathfinder(int32 InMaxNodesPerAgent = 8192);
+
+    virtual TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr) override;
+
+    virtual TArray<FIntPoint> FindAgentPath(
+        int32 AgentId,
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr) override;
+
+    virtual void ForgetAgent(int32 AgentId) override;
+
+    virtual void OnCellOccupancyChanged(const FIntPoint& Cell) override;
+
+    virtual bool SupportsConcurrentQueries() const override { return true; }
+
+    // Drops every agent's search state and the change log
+    void Reset();
+
+private:
+    static constexpr int32 Unreachable = MAX_int32 / 2;
+
+    // Log entries kept before the older half is dropped; agents that fell behind start over
+    static constexpr int32 MaxChangeLogEntries = 1 << 16;
+
+    struct FNodeState
+    {
+        int32 G = Unreachable;
+        int32 Rhs = Unreachable;
+
+        // Key of the node's live queue entry, valid while bQueued
+        int32 Key1 = 0;
+        int32 Key2 = 0;
+        bool bQueued = false;
+
+        // Whether the cell was blocked the last time this search looked at it
+        bool bBlocked = false;
+    };
+
+    struct FQueueEntry
+    {
+        int32 Key1;
+        int32 Key2;
+        int32 Index;
+
+        bool operator<(const FQueueEntry& Other) const
+        {
+            if (Key1 != Other.Key1) return Key1 < Other.Key1;
+            if (Key2 != Other.Key2) return Key2 < Other.Key2;
+            return Index < Other.Index;
+        }
+    };
+
+    struct FAgentSearch
+    {
+        int32 GridSize = 0;
+        FIntPoint Start;
+        FIntPoint Goal;
+        int32 KeyModifier = 0;
+
+        // Sequence number of the first change log entry not replayed yet
+        int64 ChangesSeen = 0;
+
+        // Inclusive bounds of the touched cells, to skip log entries far away without a lookup
+        FIntPoint BoundsMin;
+        FIntPoint BoundsMax;
+
+        TMap<int32, FNodeState> Nodes;
+        TArray<FQueueEntry> Queue;
+    };
+
+    template<typename GeometryType>
+    TArray<FIntPoint> FindAgentPath(
+        FAgentSearch& Search,
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const GeometryType& Geometry,
+        const FIntPoint* PreviousCellBias,
+        const FPathBlockers* Blockers);
+
+    // Starts Search over, rooted at Goal
+    template<typename GeometryType>
+    void Restart(FAgentSearch& Search, const FIntPoint& Start, const FIntPoint& Goal, const GeometryType& Geometry, const FPathBlockers* Blockers) const;
+
+    // Compares Cell's blocked state with what Search last saw and repairs the nodes around it
+    template<typename GeometryType>
+    void RefreshCell(FAgentSearch& Search, const FIntPoint& Cell, const GeometryType& Geometry, const FPathBlockers* Blockers) const;
+
+    template<typename GeometryType>
+    void UpdateVertex(FAgentSearch& Search, const FIntPoint& Cell, const GeometryType& Geometry, const FPathBlockers* Blockers) const;
+
+    // Returns false if the search outgrew MaxNodesPerAgent
+    template<typename GeometryType>
+    bool ComputeShortestPath(FAgentSearch& Search, const GeometryType& Geometry, const FPathBlockers* Blockers, int32& OutExpanded) const;
+
+    template<typename GeometryType>
+    void CalculateKey(const FAgentSearch& Search, const FIntPoint& Cell, const FNodeState& Node, const GeometryType& Geometry, int32& OutKey1, int32& OutKey2) const;
+
+    FAgentSearch& GetAgentSearch(int32 AgentId);
+
+    int32 MaxNodesPerAgent;
+
+    TArray<TUniquePtr<FAgentSearch>> AgentSearches;
+    FCriticalSection AgentSearchesLock;
+
+    // Cells whose occupancy changed, ChangeLog[0] being change number ChangeLogBase
+    TArray<FIntPoint> ChangeLog;
+    int64 ChangeLogBase = 0;
+
+    AStarPathfinder Fallback;
+};
@@ -0,0 +1,414 @@
+#include "JumpPointPathfinder.h"
+#include "SimulationStats.h"
+#include "Algo/Reverse.h"
+
+void FJumpPointPathfinder::FBlockedLayers::Prepare(int32 InGridSize)
+{
+    if (GridSize == InGridSize)
+        return;
+
+    GridSize = InGridSize;
+    WordsPerLine = FMath::DivideAndRoundUp(GridSize, ChunkSize);
+    Chunks.Reset();
+    Chunks.SetNum(WordsPerLine * WordsPerLine);
+    UsedChunks.Reset();
+}
+
+void FJumpPointPathfinder::FBlockedLayers::Fill(const FPathBlockers* Blockers)
+{
+    // The chunks of the last query go back to the pool; they are merged again when read
+    for (int32 Index : UsedChunks)
+    {
+        if (FreeChunks.Num() < MaxPooledChunks)
+        {
+            FreeChunks.Add(MoveTemp(Chunks[Index]));
+        }
+        else
+        {
+            Chunks[Index].Reset();
+        }
+    }
+
+    UsedChunks.Reset();
+
+    Layers = Blockers ? Blockers->Layers : nullptr;
+    if (Layers && Layers->GetGridSize() != GridSize)
+    {
+        Layers = nullptr;
+    }
+
+    bIncludeOccupancy = Layers && Blockers->bIncludeOccupancy;
+    if (!bIncludeOccupancy)
+        return;
+
+    // Merges the chunks of every ignored cell now, so chunks merged later never need them
+    for (int32 i = 0; i < Blockers->NumIgnored; ++i)
+    {
+        const FIntPoint& Cell = Blockers->Ignored[i];
+        if (Layers->IsInGrid(Cell) && !Layers->IsStaticBlocked(Cell))
+        {
+            Unblock(Cell);
+        }
+    }
+}
+
+void FJumpPointPathfinder::FBlockedLayers::Block(const FIntPoint& Cell)
+{
+    if (Cell.X < 0 || Cell.X >= GridSize || Cell.Y < 0 || Cell.Y >= GridSize)
+        return;
+
+    FChunk& Chunk = GetChunk(Cell.X >> ChunkShift, Cell.Y >> ChunkShift);
+    Chunk.Rows[Cell.Y & ChunkMask] |= uint64(1) << (Cell.X & ChunkMask);
+    Chunk.Columns[Cell.X & ChunkMask] |= uint64(1) << (Cell.Y & ChunkMask);
+}
+
+void FJumpPointPathfinder::FBlockedLayers::Unblock(const FIntPoint& Cell)
+{
+    if (Cell.X < 0 || Cell.X >= GridSize || Cell.Y < 0 || Cell.Y >= GridSize)
+        return;
+
+    FChunk& Chunk = GetChunk(Cell.X >> ChunkShift, Cell.Y >> ChunkShift);
+    Chunk.Rows[Cell.Y & ChunkMask] &= ~(uint64(1) << (Cell.X & ChunkMask));
+    Chunk.Columns[Cell.X & ChunkMask] &= ~(uint64(1) << (Cell.Y & ChunkMask));
+}
+
+void FJumpPointPathfinder::FBlockedLayers::MergeChunk(int32 Index) const
+{
+    TUniquePtr<FChunk>& Chunk = Chunks[Index];
+    Chunk = FreeChunks.Num() > 0 ? FreeChunks.Pop(EAllowShrinking::No) : MakeUnique<FChunk>();
+    UsedChunks.Add(Index);
+
+    const int32 ChunkX = Index % WordsPerLine;
+    const int32 ChunkY = Index / WordsPerLine;
+
+    // Word ChunkX of each row and word ChunkY of each column in the chunk, in the grid layers' own
+    // word layout; lines past the grid edge are never read
+    for (int32 Local = 0; Local < ChunkSize; ++Local)
+    {
+        const int32 Y = (ChunkY << ChunkShift) + Local;
+        const int32 X = (ChunkX << ChunkShift) + Local;
+
+        uint64 RowWord = 0;
+        uint64 ColumnWord = 0;
+
+        if (Layers)
+        {
+            if (Y < GridSize)
+            {
+                RowWord = Layers->GetRow(FGridLayers::ELayer::Static, Y)[ChunkX]
+                    | (bIncludeOccupancy ? Layers->GetRow(FGridLayers::ELayer::Occupancy, Y)[ChunkX] : 0);
+            }
+
+            if (X < GridSize)
+            {
+                ColumnWord = Layers->GetColumn(FGridLayers::ELayer::Static, X)[ChunkY]
+                    | (bIncludeOccupancy ? Layers->GetColumn(FGridLayers::ELayer::Occupancy, X)[ChunkY] : 0);
+            }
+        }
+
+        Chunk->Rows[Local] = RowWord;
+        Chunk->Columns[Local] = ColumnWord;
+    }
+}
+
+FJumpPointPathfinder::FScratch& FJumpPointPathfinder::GetThreadScratch()
+{
+    static thread_local FScratch Scratch;
+    return Scratch;
+}
+
+TArray<FIntPoint> FJumpPointPathfinder::FindPath(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    if (Geometry.GetShape() != EGridShape::Square)
+    {
+        return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    SIMULATION_SCOPE(FindPath);
+
+    const int32 GridSize = Geometry.GetGridSize();
+
+    auto IsInGrid = [GridSize](const FIntPoint& Cell)
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    };
+
+    if (!IsInGrid(Start) || !IsInGrid(Goal))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("JPS could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
+        SimulationStats::RecordSearch(0, false, false);
+        return {};
+    }
+
+    FScratch& Scratch = GetThreadScratch();
+    FBlockedLayers& Blocked = Scratch.Blocked;
+    Blocked.Prepare(GridSize);
+    Blocked.Fill(Blockers);
+
+    // Stepping back is only allowed when nothing else leads to the goal
+    const bool bAvoidPrevious = PreviousCellBias && *PreviousCellBias != Start && Blocked.IsFree(PreviousCellBias->X, PreviousCellBias->Y);
+    if (bAvoidPrevious)
+    {
+        Blocked.Block(*PreviousCellBias);
+    }
+
+    bool bFound = Search(Start, Goal, Scratch);
+    if (!bFound && bAvoidPrevious)
+    {
+        Blocked.Unblock(*PreviousCellBias);
+        bFound = Search(Start, Goal, Scratch);
+    }
+
+    if (!bFound)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("JPS could not find path from %s to %s"), *Start.ToString(), *Goal.ToString());
+        return {};
+    }
+
+    return ReconstructPath(Scratch.JumpPoints, GridSize, Goal.Y * GridSize + Goal.X);
+}
+
+bool FJumpPointPathfinder::Search(const FIntPoint& Start, const FIntPoint& Goal, FScratch& Scratch)
+{
+    const FBlockedLayers& Blocked = Scratch.Blocked;
+    FAStarScratch& JumpPoints = Scratch.JumpPoints;
+    const int32 GridSize = Blocked.GridSize;
+
+    JumpPoints.BeginQuery(GridSize * GridSize);
+    int32 StepsTaken = 0;
+
+    const int32 StartIndex = Start.Y * GridSize + Start.X;
+    const int32 GoalIndex = Goal.Y * GridSize + Goal.X;
+
+    JumpPoints.Frontier.HeapPush(FAStarScratch::FNode{ StartIndex, 0.0f });
+    JumpPoints.Visit(StartIndex, StartIndex, 0.0f);
+
+    auto Distance = [](const FIntPoint& A, const FIntPoint& B)
+    {
+        return static_cast<float>(FMath::Abs(A.X - B.X) + FMath::Abs(A.Y - B.Y));
+    };
+
+    while (!JumpPoints.Frontier.IsEmpty())
+    {
+        if (++StepsTaken > AStarPathfinder::MaxExpandedNodes)
+        {
+            SimulationStats::RecordSearch(JumpPoints.ClosedCells.Num(), false, true);
+            return false;
+        }
+
+        FAStarScratch::FNode Current;
+        JumpPoints.Frontier.HeapPop(Current, EAllowShrinking::No);
+
+        if (JumpPoints.IsClosed(Current.Index))
+            continue;
+
+        JumpPoints.Close(Current.Index);
+
+        if (Current.Index == GoalIndex)
+        {
+            SimulationStats::RecordSearch(JumpPoints.ClosedCells.Num(), true, false);
+            return true;
+        }
+
+        const float CurrentCost = JumpPoints.GetCost(Current.Index);
+        const FIntPoint Cell(Current.Index % GridSize, Current.Index / GridSize);
+        const int32 ParentIndex = JumpPoints.GetCameFrom(Current.Index);
+        const FIntPoint ParentCell(ParentIndex % GridSize, ParentIndex / GridSize);
+        const int32 DirX = FMath::Sign(Cell.X - ParentCell.X);
+        const int32 DirY = FMath::Sign(Cell.Y - ParentCell.Y);
+
+        auto AddSuccessor = [&](const FIntPoint& Successor)
+        {
+            const int32 SuccessorIndex = Successor.Y * GridSize + Successor.X;
+            if (JumpPoints.IsClosed(SuccessorIndex))
+                return;
+
+            const float NewCost = CurrentCost + Distance(Cell, Successor);
+            if (!JumpPoints.IsVisited(SuccessorIndex) || NewCost < JumpPoints.GetCost(SuccessorIndex))
+            {
+                JumpPoints.Visit(SuccessorIndex, Current.Index, NewCost);
+                JumpPoints.Frontier.HeapPush(FAStarScratch::FNode{ SuccessorIndex, NewCost + Distance(Successor, Goal) });
+            }
+        };
+
+        auto TryHorizontal = [&](int32 Dir)
+        {
+            const int32 X = JumpHorizontal(Blocked, Cell, Dir, Goal);
+            if (X != INDEX_NONE)
+            {
+                AddSuccessor(FIntPoint(X, Cell.Y));
+            }
+        };
+
+        auto TryVertical = [&](int32 Dir)
+        {
+            const int32 Y = JumpVertical(Blocked, Cell, Dir, Goal);
+            if (Y != INDEX_NONE)
+            {
+                AddSuccessor(FIntPoint(Cell.X, Y));
+            }
+        };
+
+        if (DirX == 0 && DirY == 0)
+        {
+            TryHorizontal(1);
+            TryHorizontal(-1);
+            TryVertical(1);
+            TryVertical(-1);
+        }
+        else if (DirX != 0)
+        {
+            // Turning vertical is always canonical after a horizontal run
+            TryHorizontal(DirX);
+            TryVertical(1);
+            TryVertical(-1);
+        }
+        else
+        {
+            // Turning horizontal is only needed past an obstacle the run just cleared
+            TryVertical(DirY);
+
+            for (int32 Side : { 1, -1 })
+            {
+                if (Blocked.IsFree(Cell.X + Side, Cell.Y) && !Blocked.IsFree(Cell.X + Side, Cell.Y - DirY))
+                {
+                    TryHorizontal(Side);
+                }
+            }
+        }
+    }
+
+    SimulationStats::RecordSearch(JumpPoints.ClosedCells.Num(), false, false);
+    return false;
+}
+
+int32 FJumpPointPathfinder::ScanColumn(const FBlockedLayers& Blocked, int32 X, int32 From, int32 Dir, int32 GoalPosition)
+{
+    const int32 GridSize = Blocked.GridSize;
+    const int32 NumWords = Blocked.WordsPerLine;
+
+    if (From < 0 || From >= GridSize)
+        return INDEX_NONE;
+
+    // Bit P is set where a side cell is free but the one before it along the scan is blocked
+    auto ForcedBits = [&Blocked, NumWords, GridSize, Dir](int32 SideX, int32 Word) -> uint64
+    {
+        if (SideX < 0 || SideX >= GridSize)
+            return 0;
+
+        const uint64 Side = Blocked.GetColumnWord(SideX, Word);
+        const uint64 Behind = Dir > 0
+            ? (Side << 1) | (Word > 0 ? Blocked.GetColumnWord(SideX, Word - 1) >> 63 : 0)
+            : (Side >> 1) | (Word + 1 < NumWords ? Blocked.GetColumnWord(SideX, Word + 1) << 63 : 0);
+
+        return ~Side & Behind;
+    };
+
+    // Drops the positions of the first word that lie behind From
+    uint64 Mask = Dir > 0 ? ~uint64(0) << (From & 63) : ~uint64(0) >> (63 - (From & 63));
+
+    for (int32 Word = From >> 6; Word >= 0 && Word < NumWords; Word += Dir, Mask = ~uint64(0))
+    {
+        const uint64 Walls = Blocked.GetColumnWord(X, Word);
+
+        uint64 Stops = Walls | ForcedBits(X - 1, Word) | ForcedBits(X + 1, Word);
+        if (GoalPosition != INDEX_NONE && (GoalPosition >> 6) == Word)
+        {
+            Stops |= uint64(1) << (GoalPosition & 63);
+        }
+
+        Stops &= Mask;
+        if (!Stops)
+            continue;
+
+        const int32 Bit = Dir > 0 ? static_cast<int32>(FMath::CountTrailingZeros64(Stops)) : static_cast<int32>(FMath::FloorLog2_64(Stops));
+        const int32 Position = Word * 64 + Bit;
+
+        // Past the end of the column, or a wall before anything worth stopping for
+        if (Position >= GridSize || (Walls & (uint64(1) << Bit)))
+            return INDEX_NONE;
+
+        return Position;
+    }
+
+    return INDEX_NONE;
+}
+
+int32 FJumpPointPathfinder::FindBlockedInRow(const FBlockedLayers& Blocked, int32 Y, int32 From, int32 Dir)
+{
+    const int32 GridSize = Blocked.GridSize;
+    const int32 End = Dir > 0 ? GridSize : -1;
+
+    if (From < 0 || From >= GridSize)
+        return End;
+
+    uint64 Mask = Dir > 0 ? ~uint64(0) << (From & 63) : ~uint64(0) >> (63 - (From & 63));
+
+    for (int32 Word = From >> 6; Word >= 0 && Word < Blocked.WordsPerLine; Word += Dir, Mask = ~uint64(0))
+    {
+        const uint64 Walls = Blocked.GetRowWord(Y, Word) & Mask;
+        if (Walls)
+        {
+            const int32 Bit = Dir > 0 ? static_cast<int32>(FMath::CountTrailingZeros64(Walls)) : static_cast<int32>(FMath::FloorLog2_64(Walls));
+            return FMath::Min(Word * 64 + Bit, GridSize);
+        }
+    }
+
+    return End;
+}
+
+int32 FJumpPointPathfinder::JumpVertical(const FBlockedLayers& Blocked, const FIntPoint& Cell, int32 DirY, const FIntPoint& Goal)
+{
+    return ScanColumn(Blocked, Cell.X, Cell.Y + DirY, DirY, Goal.X == Cell.X ? Goal.Y : INDEX_NONE);
+}
+
+int32 FJumpPointPathfinder::JumpHorizontal(const FBlockedLayers& Blocked, const FIntPoint& Cell, int32 DirX, const FIntPoint& Goal)
+{
+    const int32 Wall = FindBlockedInRow(Blocked, Cell.Y, Cell.X + DirX, DirX);
+
+    // A horizontal run has to stop wherever turning vertical would lead somewhere
+    for (int32 X = Cell.X + DirX; X != Wall; X += DirX)
+    {
+        const FIntPoint Next(X, Cell.Y);
+        if (Next == Goal
+            || JumpVertical(Blocked, Next, 1, Goal) != INDEX_NONE
+            || JumpVertical(Blocked, Next, -1, Goal) != INDEX_NONE)
+        {
+            return X;
+        }
+    }
+
+    return INDEX_NONE;
+}
+
+TArray<FIntPoint> FJumpPointPathfinder::ReconstructPath(const FAStarScratch& Scratch, int32 GridSize, int32 GoalIndex)
+{
+    TArray<FIntPoint> Path;
+
+    int32 Index = GoalIndex;
+    FIntPoint Cell(Index % GridSize, Index / GridSize);
+    Path.Add(Cell);
+
+    while (Scratch.GetCameFrom(Index) != Index)
+    {
+        const int32 ParentIndex = Scratch.GetCameFrom(Index);
+        const FIntPoint ParentCell(ParentIndex % GridSize, ParentIndex / GridSize);
+        const FIntPoint Step(FMath::Sign(ParentCell.X - Cell.X), FMath::Sign(ParentCell.Y - Cell.Y));
+
+        while (Cell != ParentCell)
+        {
+            Cell += Step;
+            Path.Add(Cell);
+        }
+
+        Index = ParentIndex;
+    }
+
+    Algo::Reverse(Path);
+    return Path;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathfinder.h"
+#include "AStarPathfinder.h"
+
+/*
+====================================================================================
+  FJumpPointPathfinder - Jump Point Search for 4-connected square grids
+====================================================================================
+
+- Only searches paths in canonical order: horizontal runs first, turning vertical
+  freely and back to horizontal only where an obstacle forces it (JPS4). Straight
+  runs are skipped in one jump instead of pushing every cell through the open list.
+- Each query merges the static and occupancy layers of FGridLayers, which are kept
+  by rows and by columns, into its own bit layers, one 64 x 64 chunk at a time the
+  first time a jump reads that chunk. A jump along either axis tests 64 cells per word: the cells it has to stop on (walls, forced neighbours,
+  the goal) are found with a few shifts and a count-trailing-zeros.
+- Blocked cells are never entered. PreviousCellBias is honoured by searching
+  with that cell blocked first and only allowing it when there is no other way,
+  which is what A*'s 10000 penalty amounts to on grids of this size.
+- Returns the same path lengths as AStarPathfinder, though among equally short paths
+  it may pick a different one. Paths are expanded back to adjacent cells.
+
+Notes:
+- Square grids only; given any other geometry it falls back to AStarPathfinder.
+- A query only merges and holds the chunks it reads (1 KB each). Between queries a
+  thread keeps at most MaxPooledChunks of them plus one pointer per chunk of the grid
+  (128 KB on an 8192 x 8192 grid).
+- Jump points are searched in an FAStarScratch, so they give up after
+  AStarPathfinder::MaxExpandedNodes like A*.
+*/
+
+class FJumpPointPathfinder final : public IPathfinder
+{
+public:
+    virtual TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr) override;
+
+    // Every thread searches in its own scratch
+    virtual bool SupportsConcurrentQueries() const override { return true; }
+
+private:
+    // Blocked cells of the current query, kept in ChunkSize x ChunkSize chunks that each hold the
+    // chunk's rows (bit LocalX of word LocalY) and columns (bit LocalY of word LocalX). A chunk is
+    // merged from the grid layers the first time the query reads it.
+    struct FBlockedLayers
+    {
+        static constexpr int32 ChunkSize = 64;
+        static constexpr int32 ChunkShift = 6;
+        static constexpr int32 ChunkMask = ChunkSize - 1;
+        static constexpr int32 MaxPooledChunks = 1024;
+
+        int32 GridSize = 0;
+
+        // Words per row or column, which is also the number of chunks per side
+        int32 WordsPerLine = 0;
+
+        void Prepare(int32 InGridSize);
+
+        // Starts a new query against the cells Blockers blocks
+        void Fill(const FPathBlockers* Blockers);
+
+        void Block(const FIntPoint& Cell);
+        void Unblock(const FIntPoint& Cell);
+
+        // Bit B of word Word of row Y is the cell (Word * 64 + B, Y)
+        FORCEINLINE uint64 GetRowWord(int32 Y, int32 Word) const { return GetChunk(Word, Y >> ChunkShift).Rows[Y & ChunkMask]; }
+
+        // Bit B of word Word of column X is the cell (X, Word * 64 + B)
+        FORCEINLINE uint64 GetColumnWord(int32 X, int32 Word) const { return GetChunk(X >> ChunkShift, Word).Columns[X & ChunkMask]; }
+
+        FORCEINLINE bool IsFree(int32 X, int32 Y) const
+        {
+            return X >= 0 && X < GridSize && Y >= 0 && Y < GridSize
+                && !(GetRowWord(Y, X >> ChunkShift) & (uint64(1) << (X & ChunkMask)));
+        }
+
+    private:
+        static_assert(ChunkSize == 1 << ChunkShift && ChunkSize == 64, "A chunk line is one uint64 of blocked bits");
+
+        struct FChunk
+        {
+            uint64 Rows[ChunkSize];
+            uint64 Columns[ChunkSize];
+        };
+
+        FORCEINLINE FChunk& GetChunk(int32 ChunkX, int32 ChunkY) const
+        {
+            const int32 Index = ChunkY * WordsPerLine + ChunkX;
+            if (!Chunks[Index])
+            {
+                MergeChunk(Index);
+            }
+
+            return *Chunks[Index];
+        }
+
+        // Takes a chunk from the pool, or allocates one, and fills it from the query's layers
+        void MergeChunk(int32 Index) const;
+
+        // One slot per chunk, null until the current query reads it
+        mutable TArray<TUniquePtr<FChunk>> Chunks;
+
+        // Slots filled since the last Fill()
+        mutable TArray<int32> UsedChunks;
+
+        mutable TArray<TUniquePtr<FChunk>> FreeChunks;
+
+        // Null when the query has no layers or they were built for another grid size
+        const FGridLayers* Layers = nullptr;
+        bool bIncludeOccupancy = false;
+    };
+
+    struct FScratch
+    {
+        FBlockedLayers Blocked;
+        FAStarScratch JumpPoints;
+    };
+
+    static FScratch& GetThreadScratch();
+
+    // Runs the search against the layers in Scratch; on success Scratch.JumpPoints.CameFrom links jump points
+    static bool Search(const FIntPoint& Start, const FIntPoint& Goal, FScratch& Scratch);
+
+    // First position from From in direction Dir along column X where a jump has to stop: a
+    // cell with a forced neighbour in a column beside it, or GoalPosition.
+    // INDEX_NONE if a blocked cell or the end of the column comes first.
+    static int32 ScanColumn(const FBlockedLayers& Blocked, int32 X, int32 From, int32 Dir, int32 GoalPosition);
+
+    // First blocked position from From in direction Dir along row Y, or one past the grid edge
+    static int32 FindBlockedInRow(const FBlockedLayers& Blocked, int32 Y, int32 From, int32 Dir);
+
+    static int32 JumpVertical(const FBlockedLayers& Blocked, const FIntPoint& Cell, int32 DirY, const FIntPoint& Goal);
+    static int32 JumpHorizontal(const FBlockedLayers& Blocked, const FIntPoint& Cell, int32 DirX, const FIntPoint& Goal);
+
+    // Fills in the straight runs between the jump points Search() linked
+    static TArray<FIntPoint> ReconstructPath(const FAStarScratch& Scratch, int32 GridSize, int32 GoalIndex);
+
+    // Answers queries on geometries other than FSquareGrid
+    AStarPathfinder Fallback;
+};
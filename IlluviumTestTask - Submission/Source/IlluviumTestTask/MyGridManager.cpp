@@ -3,7 +3,9 @@
 #include "Engine/World.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "GridSpatialPartition.h"
+#include "SimulationStats.h"
 #include "UObject/ConstructorHelpers.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
 
 UMyGridManager::UMyGridManager(const FObjectInitializer& ObjectInitializer)
     : Super(ObjectInitializer)
@@ -14,66 +16,225 @@ UMyGridManager::UMyGridManager()
 {
 }
 
-void UMyGridManager::InitializeGrid(int32 Size)
+void UMyGridManager::InitializeGrid(int32 Size, TConstArrayView<FIntPoint> StaticObstacles)
 {
+    SIMULATION_SCOPE(InitializeGrid);
+
     GridSize = Size;
-    WalkableMap.Empty();
+    Layers.Reset(Size);
     SpawnedTiles.Empty();
 
+    for (UHierarchicalInstancedStaticMeshComponent* Instances : TileInstances)
+    {
+        if (IsValid(Instances))
+        {
+            Instances->DestroyComponent();
+        }
+    }
+    TileInstances.Reset();
+
     SpatialPartition = NewObject<UGridSpatialPartition>(this);
     SpatialPartition->Initialize(Size);
 
-    for (int32 X = 0; X < GridSize; ++X)
+    for (const FIntPoint& Cell : StaticObstacles)
     {
-        for (int32 Y = 0; Y < GridSize; ++Y)
+        if (!IsValidCell(Cell))
         {
-            FIntPoint Coord(X, Y);
-            WalkableMap.Add(Coord, true);
+            UE_LOG(LogTemp, Warning, TEXT("Static obstacle %s is outside the %d grid and is ignored."), *Cell.ToString(), GridSize);
+            continue;
+        }
+
+        Layers.Set(FGridLayers::ELayer::Static, Cell, true);
+    }
+
+    TileChunksPerSide = FMath::DivideAndRoundUp(FMath::Max(Size, 0), TileChunkSize);
+    BuiltTileChunks.Init(false, TileChunksPerSide * TileChunksPerSide);
+    bBuildTiles = WorldContext && TileActorClass && CanBuildTileInstances();
 
-            if (WorldContext && TileActorClass)
+    // Small grids are drawn whole; bigger ones get their floor where agents register and move
+    if (bBuildTiles && GridSize <= MaxEagerTiledGridSize)
+    {
+        for (int32 ChunkY = 0; ChunkY < TileChunksPerSide; ++ChunkY)
+        {
+            for (int32 ChunkX = 0; ChunkX < TileChunksPerSide; ++ChunkX)
             {
-                FVector WorldPos = GridGeometry->GetTileWorldPosition(Coord, GridOrigin);
-                FActorSpawnParameters Params;
-                Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+                BuildTileChunk(ChunkX, ChunkY);
+            }
+        }
+    }
+}
 
-                if (!ensure(TileActorClass && TileActorClass->IsChildOf(ATileActor::StaticClass())))
-                {
-                    UE_LOG(LogTemp, Error, TEXT("TileActorClass is invalid or not a subclass of ATileActor."));
-                    return;
-                }
+bool UMyGridManager::CanBuildTileInstances() const
+{
+    if (!ensure(TileActorClass && TileActorClass->IsChildOf(ATileActor::StaticClass())))
+    {
+        UE_LOG(LogTemp, Error, TEXT("TileActorClass is invalid or not a subclass of ATileActor."));
+        return false;
+    }
 
-                ATileActor* Tile = WorldContext->SpawnActor<ATileActor>(TileActorClass, WorldPos, FRotator::ZeroRotator, Params);
-                if (Tile)
-                {
-                    Tile->SetGridCoord(Coord);
-                    SpawnedTiles.Add(Coord, Tile);
-
-                    if ((X + Y) % 2 == 0 && Tile->DefaultMaterial)
-                    {
-                        Tile->GetStaticMeshComponent()->SetMaterial(0, Tile->DefaultMaterial);
-                    }
-                    else if (Tile->AlternateMaterial)
-                    {
-                        Tile->GetStaticMeshComponent()->SetMaterial(0, Tile->AlternateMaterial);
-                    }
-
-                    if (OwningActor)
-                    {
-                        Tile->AttachToActor(OwningActor, FAttachmentTransformRules::KeepWorldTransform);
-                    }
-                }
+    if (!OwningActor || !OwningActor->GetRootComponent())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Tile instances need an owning actor with a root component to attach to."));
+        return false;
+    }
+
+    const UStaticMeshComponent* TileMesh = TileActorClass->GetDefaultObject<ATileActor>()->GetStaticMeshComponent();
+    if (!TileMesh || !TileMesh->GetStaticMesh())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Tile class %s has no static mesh."), *TileActorClass->GetName());
+        return false;
+    }
+
+    return true;
+}
+
+void UMyGridManager::BuildTileChunksAround(const FIntPoint& Cell)
+{
+    if (!bBuildTiles || !IsValidCell(Cell))
+        return;
+
+    // The neighbouring chunks too, so the floor already reaches past an agent nearing a chunk edge
+    const int32 CenterX = Cell.X / TileChunkSize;
+    const int32 CenterY = Cell.Y / TileChunkSize;
+
+    for (int32 ChunkY = FMath::Max(CenterY - 1, 0); ChunkY <= FMath::Min(CenterY + 1, TileChunksPerSide - 1); ++ChunkY)
+    {
+        for (int32 ChunkX = FMath::Max(CenterX - 1, 0); ChunkX <= FMath::Min(CenterX + 1, TileChunksPerSide - 1); ++ChunkX)
+        {
+            if (!BuiltTileChunks[ChunkY * TileChunksPerSide + ChunkX])
+            {
+                BuildTileChunk(ChunkX, ChunkY);
             }
         }
     }
 }
 
-void UMyGridManager::RegisterAgent(ABallAgent* Agent)
+void UMyGridManager::BuildTileChunk(int32 ChunkX, int32 ChunkY)
 {
-    if (!SpatialPartition || !Agent) return;
+    BuiltTileChunks[ChunkY * TileChunksPerSide + ChunkX] = true;
+
+    // The tile Blueprint defaults describe every tile: mesh, its offset and the two checkerboard materials
+    const ATileActor* TileDefaults = TileActorClass->GetDefaultObject<ATileActor>();
+    const UStaticMeshComponent* TileMesh = TileDefaults->GetStaticMeshComponent();
+
+    struct FTileBatch
+    {
+        UMaterialInterface* Material = nullptr;
+        TArray<FTransform> Transforms;
+        TArray<float> Parities;
+    };
+
+    TArray<FTileBatch, TInlineAllocator<2>> Batches;
+    const FTransform MeshTransform = TileMesh->GetRelativeTransform();
+
+    const int32 MinX = ChunkX * TileChunkSize;
+    const int32 MinY = ChunkY * TileChunkSize;
+    const int32 MaxX = FMath::Min(MinX + TileChunkSize, GridSize);
+    const int32 MaxY = FMath::Min(MinY + TileChunkSize, GridSize);
+
+    for (int32 X = MinX; X < MaxX; ++X)
+    {
+        for (int32 Y = MinY; Y < MaxY; ++Y)
+        {
+            const FIntPoint Coord(X, Y);
 
-    FIntPoint Cell = WorldToGrid(Agent->GetCurrentWorldPosition());
-    SpatialPartition->RegisterAgent(Agent, Cell);
-    AgentToPreviousCellMap.Add(Agent, Cell);
+            // Static obstacles are left as holes in the floor
+            if (Layers.IsStaticBlocked(Coord))
+                continue;
+
+            const int32 Parity = (X + Y) % 2;
+            UMaterialInterface* Material = GetTileMaterial(*TileDefaults, Coord);
+
+            FTileBatch* Batch = Batches.FindByPredicate([Material](const FTileBatch& B) { return B.Material == Material; });
+            if (!Batch)
+            {
+                Batch = &Batches.AddDefaulted_GetRef();
+                Batch->Material = Material;
+                Batch->Transforms.Reserve(TileChunkSize * TileChunkSize);
+                Batch->Parities.Reserve(TileChunkSize * TileChunkSize);
+            }
+
+            Batch->Transforms.Add(MeshTransform * FTransform(GridToWorld(Coord)));
+            Batch->Parities.Add(static_cast<float>(Parity));
+        }
+    }
+
+    for (const FTileBatch& Batch : Batches)
+    {
+        UHierarchicalInstancedStaticMeshComponent* Instances = NewObject<UHierarchicalInstancedStaticMeshComponent>(OwningActor);
+        Instances->SetStaticMesh(TileMesh->GetStaticMesh());
+        if (Batch.Material)
+        {
+            Instances->SetMaterial(0, Batch.Material);
+        }
+        Instances->SetCollisionProfileName(TileMesh->GetCollisionProfileName());
+        Instances->SetupAttachment(OwningActor->GetRootComponent());
+        Instances->RegisterComponent();
+        OwningActor->AddInstanceComponent(Instances);
+
+        // Custom data 0 holds the checkerboard parity, for materials that alternate by themselves
+        Instances->SetNumCustomDataFloats(1);
+        Instances->AddInstances(Batch.Transforms, false, true);
+        for (int32 i = 0; i < Batch.Parities.Num(); ++i)
+        {
+            Instances->SetCustomDataValue(i, 0, Batch.Parities[i], false);
+        }
+        Instances->MarkRenderStateDirty();
+
+        TileInstances.Add(Instances);
+    }
+}
+
+UMaterialInterface* UMyGridManager::GetTileMaterial(const ATileActor& Tile, const FIntPoint& Coord)
+{
+    if ((Coord.X + Coord.Y) % 2 == 0 && Tile.DefaultMaterial)
+    {
+        return Tile.DefaultMaterial;
+    }
+
+    return Tile.AlternateMaterial;
+}
+
+ATileActor* UMyGridManager::GetOrSpawnTileActor(const FIntPoint& Coord)
+{
+    if (ATileActor** Existing = SpawnedTiles.Find(Coord))
+    {
+        return *Existing;
+    }
+
+    if (!WorldContext || !TileActorClass || !IsValidCell(Coord))
+        return nullptr;
+
+    FActorSpawnParameters Params;
+    Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+    ATileActor* Tile = WorldContext->SpawnActor<ATileActor>(TileActorClass, GridToWorld(Coord), FRotator::ZeroRotator, Params);
+    if (!Tile)
+        return nullptr;
+
+    Tile->SetGridCoord(Coord);
+    SpawnedTiles.Add(Coord, Tile);
+
+    if (UMaterialInterface* Material = GetTileMaterial(*Tile, Coord))
+    {
+        Tile->GetStaticMeshComponent()->SetMaterial(0, Material);
+    }
+
+    if (OwningActor)
+    {
+        Tile->AttachToActor(OwningActor, FAttachmentTransformRules::KeepWorldTransform);
+    }
+
+    return Tile;
+}
+
+void UMyGridManager::RegisterAgent(int32 AgentId, ETeam Team, const FIntPoint& Cell)
+{
+    if (!SpatialPartition || AgentId == INDEX_NONE) return;
+
+    SpatialPartition->RegisterAgent(AgentId, Team, Cell);
+    NotifyOccupancyChanged(Cell);
+    BuildTileChunksAround(Cell);
 }
 
 bool UMyGridManager::IsValidCell(const FIntPoint& Cell) const
@@ -84,7 +245,9 @@ bool UMyGridManager::IsValidCell(const FIntPoint& Cell) const
 TArray<FIntPoint> UMyGridManager::GetPath(const FIntPoint& From, const FIntPoint& To) const
 {
     if (!Pathfinder || !GridGeometry) return {};
-    return Pathfinder->FindPath(From, To, *GridGeometry);
+
+    const FPathBlockers StaticObstacles(Layers, false);
+    return Pathfinder->FindPath(From, To, *GridGeometry, nullptr, &StaticObstacles);
 }
 
 FVector UMyGridManager::GridToWorld(const FIntPoint& Cell) const
@@ -97,124 +260,195 @@ FIntPoint UMyGridManager::WorldToGrid(const FVector& WorldLocation) const
     return GridGeometry ? GridGeometry->WorldToGrid(WorldLocation - GridOrigin) : FIntPoint::ZeroValue;
 }
 
-void UMyGridManager::UpdateAgentPosition(ABallAgent* Agent, const FIntPoint& NewCell)
+void UMyGridManager::UpdateAgentPosition(int32 AgentId, const FIntPoint& OldCell, const FIntPoint& NewCell)
 {
-    if (!SpatialPartition || !IsValid(Agent) || !GridGeometry.IsValid() || !IsValidCell(NewCell))
+    if (!SpatialPartition || AgentId == INDEX_NONE || !IsValidCell(NewCell))
         return;
 
     // Only update if the cell actually changed
-    if (const FIntPoint* ExistingCell = AgentToPreviousCellMap.Find(Agent))
-    {
-        if (*ExistingCell == NewCell)
-        {
-            return; // Cell hasn't changed, skip update
-        }
+    if (OldCell == NewCell)
+        return;
 
-        // Update the spatial partition with the new cell
-        SpatialPartition->UpdateAgentCell(Agent, *ExistingCell, NewCell);
-        AgentToPreviousCellMap[Agent] = NewCell;
-    }
-    else
-    {
-        // First-time registration
-        AgentToPreviousCellMap.Add(Agent, NewCell);
-        SpatialPartition->RegisterAgent(Agent, NewCell);
-    }
+    SpatialPartition->UpdateAgentCell(AgentId, OldCell, NewCell);
+    NotifyOccupancyChanged(OldCell);
+    NotifyOccupancyChanged(NewCell);
+    BuildTileChunksAround(NewCell);
 }
 
-FIntPoint UMyGridManager::GetPreviousCellForAgent(ABallAgent* Agent) const
+void UMyGridManager::RemoveAgent(int32 AgentId, const FIntPoint& Cell)
 {
-    if (const FIntPoint* Ptr = AgentToPreviousCellMap.Find(Agent))
-    {
-        return *Ptr;
-    }
-    return WorldToGrid(Agent->GetCurrentWorldPosition()); // fallback
+    if (!SpatialPartition || AgentId == INDEX_NONE)
+        return;
+
+    SpatialPartition->RemoveAgent(AgentId, Cell);
+    NotifyOccupancyChanged(Cell);
 }
 
-void UMyGridManager::RemoveAgent(ABallAgent* Agent)
+void UMyGridManager::NotifyOccupancyChanged(const FIntPoint& Cell)
 {
-    if (!IsValid(Agent) || !SpatialPartition || !GridGeometry.IsValid())
-        return;
+    // Read back from the partition, which knows whether another agent is still on the cell
+    Layers.Set(FGridLayers::ELayer::Occupancy, Cell, SpatialPartition->IsCellOccupied(Cell));
 
-    // Get the cell the system registered the agent in
-    if (FIntPoint* TrackedCell = AgentToPreviousCellMap.Find(Agent))
+    if (Pathfinder)
     {
-        SpatialPartition->RemoveAgent(Agent, *TrackedCell);
-        AgentToPreviousCellMap.Remove(Agent);
-    }
-    else
-    {
-        // Fallback: remove based on current world position
-        const FVector& CurrentPosition = Agent->GetCurrentWorldPosition();
-        const FIntPoint Cell = GridGeometry->WorldToGrid(CurrentPosition);
-        SpatialPartition->RemoveAgent(Agent, Cell);
+        Pathfinder->OnCellOccupancyChanged(Cell);
     }
 }
 
-TArray<ABallAgent*> UMyGridManager::GetSurroundingAgents(const FIntPoint& Center, int32 Range) const
+void UMyGridManager::GetSurroundingAgents(const FIntPoint& Center, int32 Range, TStepArray<int32>& OutAgents) const
 {
-    TArray<ABallAgent*> Result;
+    SimulationStats::Add(ESimulationCounter::SpatialQueries);
+
+    TStepArray<FIntPoint> Cells;
+    GridGeometry->GetCellsInRange(Center, Range, Cells);
 
-    TArray<FIntPoint> Cells = GridGeometry->GetCellsInRange(Center, Range);
     for (const FIntPoint& Cell : Cells)
     {
-        if (const TSet<ABallAgent*>* Agents = SpatialPartition->GetAgentsAt(Cell))
+        const int32 AgentId = SpatialPartition->GetAgentAt(Cell);
+        if (AgentId != INDEX_NONE)
         {
-            Result.Append(Agents->Array());
+            OutAgents.Add(AgentId);
         }
     }
-
-    return Result;
 }
 
-TArray<ABallAgent*> UMyGridManager::GetNeighbouringAgents(const FIntPoint& Center) const
+void UMyGridManager::GetNeighbouringAgents(const FIntPoint& Center, TStepArray<int32>& OutAgents) const
 {
-    TArray<ABallAgent*> Result;
+    SimulationStats::Add(ESimulationCounter::SpatialQueries);
 
     if (!GridGeometry || !SpatialPartition)
-        return Result;
+        return;
 
     // Get the neighbors via the geometry interface (4 orthogonal for square, 6 for hex)
-    TArray<FIntPoint> Neighbors = GridGeometry->GetNeighbors(Center);
+    const FGridNeighbors Neighbors = GridGeometry->GetNeighbors(Center);
 
     for (const FIntPoint& Cell : Neighbors)
     {
-        if (const TSet<ABallAgent*>* Agents = SpatialPartition->GetAgentsAt(Cell))
+        const int32 AgentId = SpatialPartition->GetAgentAt(Cell);
+        if (AgentId != INDEX_NONE)
         {
-            Result.Append(Agents->Array());
+            OutAgents.Add(AgentId);
         }
     }
-
-    return Result;
 }
 
-float UMyGridManager::GetTileSize() const
+int32 UMyGridManager::FindNearestEnemy(const FIntPoint& Center, ETeam SeekerTeam, int32 MaxRadius) const
 {
-    return GridGeometry.IsValid() ? GridGeometry->GetTileSize() : 0.0f;
-}
+    SimulationStats::Add(ESimulationCounter::SpatialQueries);
 
-bool UMyGridManager::IsOccupied(const FIntPoint& Cell) const
-{
-    if (!SpatialPartition)
-    {
-        return false;
-    }
+    if (!GridGeometry || !SpatialPartition)
+        return INDEX_NONE;
+
+    const ETeam EnemyTeam = (SeekerTeam == ETeam::Red) ? ETeam::Blue : ETeam::Red;
+    if (SpatialPartition->GetTeamAgentCount(EnemyTeam) == 0)
+        return INDEX_NONE;
+
+    const FVector SeekerLocation = GridToWorld(Center);
+    int32 ClosestEnemy = INDEX_NONE;
+    float ClosestDistSq = TNumericLimits<float>::Max();
 
-    const TSet<ABallAgent*>* Agents = SpatialPartition->GetAgentsAt(Cell);
-    if (!Agents)
+    FStepArenaScope ArenaScope;
+    TStepArray<FIntPoint> RingCells;
+
+    for (int32 Radius = 1; Radius <= MaxRadius; ++Radius)
     {
-        return false;
+        // Nearby enemies are found by scanning directly; once the first block's worth of rings came up
+        // empty, jump straight to the first ring that can reach a block holding an enemy
+        if (Radius == UGridSpatialPartition::BlockSize + 1)
+        {
+            Radius = FMath::Max(Radius, GetFirstRingWithTeam(Center, EnemyTeam));
+            if (Radius > MaxRadius)
+                break;
+        }
+
+        RingCells.Reset();
+        GridGeometry->GetCellsInRing(Center, Radius, RingCells);
+
+        bool bAnyCellInGrid = false;
+        for (const FIntPoint& Cell : RingCells)
+        {
+            if (!IsValidCell(Cell))
+                continue;
+
+            bAnyCellInGrid = true;
+            if (!SpatialPartition->IsCellOccupiedByTeam(Cell, EnemyTeam))
+                continue;
+
+            // Agents leave the partition as soon as they die, so every registered enemy is a candidate
+            float DistSq = FVector::DistSquared(SeekerLocation, GridToWorld(Cell));
+            if (DistSq < ClosestDistSq)
+            {
+                ClosestDistSq = DistSq;
+                ClosestEnemy = SpatialPartition->GetAgentAt(Cell);
+            }
+        }
+
+        // Stop as soon as a valid enemy is found in this ring, or once the rings have left the grid
+        if (ClosestEnemy != INDEX_NONE || !bAnyCellInGrid)
+            break;
     }
 
-    for (ABallAgent* Agent : *Agents)
+    return ClosestEnemy;
+}
+
+int32 UMyGridManager::GetFirstRingWithTeam(const FIntPoint& Center, ETeam Team) const
+{
+    const int32 ChunkSize = UGridSpatialPartition::ChunkSize;
+    const int32 BlockSize = UGridSpatialPartition::BlockSize;
+    const int32 BlocksPerChunk = UGridSpatialPartition::BlocksPerChunk;
+    const int32 ChunksPerSide = SpatialPartition->GetChunksPerSide();
+    int32 FirstRing = MAX_int32;
+
+    // Lowest ring that can reach the square of cells [Min, Min + Size) clamped to the grid
+    auto GetLowerBound = [this, &Center](const FIntPoint& Min, int32 Size)
     {
-        if (Agent && Agent->IsAlive())
+        const FIntPoint Max(FMath::Min(Min.X + Size, GridSize) - 1, FMath::Min(Min.Y + Size, GridSize) - 1);
+        const int32 DeltaX = Center.X < Min.X ? Min.X - Center.X : FMath::Max(Center.X - Max.X, 0);
+        const int32 DeltaY = Center.Y < Min.Y ? Min.Y - Center.Y : FMath::Max(Center.Y - Max.Y, 0);
+        return GridGeometry->GetDistanceLowerBound(FIntPoint(DeltaX, DeltaY));
+    };
+
+    // Chunks without an agent of Team are skipped whole, and so are chunks that cannot beat the best ring so far
+    for (int32 ChunkY = 0; ChunkY < ChunksPerSide; ++ChunkY)
+    {
+        for (int32 ChunkX = 0; ChunkX < ChunksPerSide; ++ChunkX)
         {
-            return true;
+            if (SpatialPartition->GetTeamChunkCount(Team, ChunkX, ChunkY) == 0
+                || GetLowerBound(FIntPoint(ChunkX, ChunkY) * ChunkSize, ChunkSize) >= FirstRing)
+                continue;
+
+            for (int32 LocalY = 0; LocalY < BlocksPerChunk; ++LocalY)
+            {
+                for (int32 LocalX = 0; LocalX < BlocksPerChunk; ++LocalX)
+                {
+                    const FIntPoint Block(ChunkX * BlocksPerChunk + LocalX, ChunkY * BlocksPerChunk + LocalY);
+                    if (Block.X * BlockSize >= GridSize || Block.Y * BlockSize >= GridSize
+                        || SpatialPartition->GetTeamBlockCount(Team, Block.X, Block.Y) == 0)
+                        continue;
+
+                    FirstRing = FMath::Min(FirstRing, GetLowerBound(Block * BlockSize, BlockSize));
+                }
+            }
         }
     }
 
-    return false;
+    return FirstRing;
+}
+
+float UMyGridManager::GetTileSize() const
+{
+    return GridGeometry.IsValid() ? GridGeometry->GetTileSize() : 0.0f;
+}
+
+bool UMyGridManager::IsOccupied(const FIntPoint& Cell) const
+{
+    // Agents leave the partition as soon as they die, so any registered agent is a living one
+    return SpatialPartition && SpatialPartition->IsCellOccupied(Cell);
+}
+
+bool UMyGridManager::IsWalkable(const FIntPoint& Cell) const
+{
+    return IsValidCell(Cell) && !Layers.IsStaticBlocked(Cell);
 }
 
 void UMyGridManager::SetGridGeometry(TSharedPtr<IGridGeometry> InGeometry)
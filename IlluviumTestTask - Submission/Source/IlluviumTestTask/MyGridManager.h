@@ -5,7 +5,8 @@
 #include "GridSpatialPartition.h"
 #include "IGridGeometry.h"
 #include "IPathfinder.h"
-#include "BallAgent.h"
+#include "GridLayers.h"
+#include "SimulationTypes.h"
 #include "MyGridManager.generated.h"
 
 /*
@@ -16,18 +17,27 @@
 - Handles grid initialization, agent registration, and spatial queries.
 
 Responsibilities:
-• Tile Spawning                → Spawns tile actors and assigns materials.
+• Tile Rendering               → Draws tiles through instanced mesh components, one per
+                                 material and 64x64 chunk; tile actors are only spawned on request.
 • Grid-to-World Conversion     → Maps between grid coordinates and world space.
 • Agent Spatial Partitioning   → Tracks agent positions on the grid.
+• Blocking Layers              → Keeps static obstacles and occupancy as FGridLayers,
+                                 the bit layers pathfinders read through FPathBlockers.
 
 Notes:
 - Holds a reference to UGridSpatialPartition and acts as an interface for querying
   spatial information such as nearby or neighboring agents.
 - Maintains internal state about walkability, occupancy, and logical grid size.
 - Used by USimulationSystem to interact with the grid and drive agent behavior.
+- Agent positions live in the partition's chunks, allocated where agents go, and the
+  blocking layers take one bit per cell, so grids of thousands of cells per side set
+  up quickly. Grids up to MaxEagerTiledGridSize cells per side get their whole floor at
+  once; bigger ones build a floor chunk when an agent enters it or one next to it, so the
+  number of tile instances follows the area the armies cover.
 */
 
 class ATileActor;
+class UHierarchicalInstancedStaticMeshComponent;
 
 UCLASS()
 class UMyGridManager : public UObject
@@ -44,25 +54,39 @@ public:
     void SetWorld(UWorld* InWorld);
     void SetGridOrigin(FVector InOrigin);
     void SetOwningActor(AActor* InActor);
-    void InitializeGrid(int32 Size);
+    // StaticObstacles stay unwalkable for the whole battle; cells outside the grid are skipped
+    void InitializeGrid(int32 Size, TConstArrayView<FIntPoint> StaticObstacles = {});
 
-    void RegisterAgent(ABallAgent* Agent);
-    void RemoveAgent(ABallAgent* Agent);
+    void RegisterAgent(int32 AgentId, ETeam Team, const FIntPoint& Cell);
+    void RemoveAgent(int32 AgentId, const FIntPoint& Cell);
 
-    void UpdateAgentPosition(ABallAgent* Agent, const FIntPoint& NewCell);
-    FIntPoint GetPreviousCellForAgent(ABallAgent* Agent) const;
+    void UpdateAgentPosition(int32 AgentId, const FIntPoint& OldCell, const FIntPoint& NewCell);
 
     bool IsValidCell(const FIntPoint& Cell) const;
     bool IsOccupied(const FIntPoint& Cell) const;
 
-    //Agents that surround the given agent within the given radius
-    TArray<ABallAgent*> GetSurroundingAgents(const FIntPoint& Center, int32 Range) const;
+    // In the grid and not a static obstacle
+    bool IsWalkable(const FIntPoint& Cell) const;
 
-    //Neighbours which can be traversed to with the cost of 1 tile
-    TArray<ABallAgent*> GetNeighbouringAgents(const FIntPoint& Center) const;
+    // Static obstacles and occupancy, updated as agents register, move and leave
+    const FGridLayers& GetLayers() const { return Layers; }
 
+    //Appends the ids of the agents that surround the given agent within the given radius; the caller owns the arena scope
+    void GetSurroundingAgents(const FIntPoint& Center, int32 Range, TStepArray<int32>& OutAgents) const;
+
+    //Appends the agents on the neighbours which can be traversed to with the cost of 1 tile; the caller owns the arena scope
+    void GetNeighbouringAgents(const FIntPoint& Center, TStepArray<int32>& OutAgents) const;
+
+    //Id of the closest agent not in SeekerTeam (by world distance between cell centres) on the nearest ring
+    //around Center that holds one. Rings are visited once each, outwards, and stop at the first ring with a match.
+    int32 FindNearestEnemy(const FIntPoint& Center, ETeam SeekerTeam, int32 MaxRadius) const;
+
+    // Path around static obstacles only; agents in the way are ignored
     TArray<FIntPoint> GetPath(const FIntPoint& From, const FIntPoint& To) const;
 
+    //Tile actor for a cell that needs interaction, spawned on top of its instance on first request
+    ATileActor* GetOrSpawnTileActor(const FIntPoint& Coord);
+
     FVector GridToWorld(const FIntPoint& Cell) const;
     FIntPoint WorldToGrid(const FVector& WorldLocation) const;
 
@@ -75,14 +99,47 @@ public:
     UWorld* GetWorld() const { return WorldContext; }
 
 private:
+    // Whether TileActorClass describes a tile that can be drawn with instances
+    bool CanBuildTileInstances() const;
+
+    // Builds the floor chunks around Cell's chunk that have not been built yet
+    void BuildTileChunksAround(const FIntPoint& Cell);
+
+    // Adds one instance per walkable cell of the chunk, grouped into one component per tile material
+    void BuildTileChunk(int32 ChunkX, int32 ChunkY);
+
+    // Material a tile at Coord gets: checkerboard of DefaultMaterial and AlternateMaterial
+    static UMaterialInterface* GetTileMaterial(const ATileActor& Tile, const FIntPoint& Coord);
+
+    // Refreshes Cell's occupancy bit and lets pathfinders that keep results between queries
+    // know that Cell gained or lost an agent
+    void NotifyOccupancyChanged(const FIntPoint& Cell);
+
+    // Lowest ring around Center that can reach a block holding an agent of Team
+    int32 GetFirstRingWithTeam(const FIntPoint& Center, ETeam Team) const;
+
+    // Cells per side of a floor chunk, matching the chunks of UGridSpatialPartition
+    static constexpr int32 TileChunkSize = 64;
+
+    // Bigger grids would need millions of tile instances up front, so their floor is built chunk by chunk
+    static constexpr int32 MaxEagerTiledGridSize = 1024;
+
     int32 GridSize;
 
-    TMap<FIntPoint, bool> WalkableMap;
+    // One bit per floor chunk, set once its instances exist
+    TBitArray<> BuiltTileChunks;
+    int32 TileChunksPerSide = 0;
+    bool bBuildTiles = false;
+
+    FGridLayers Layers;
     TMap<FIntPoint, ATileActor*> SpawnedTiles;
 
     TSharedPtr<IGridGeometry> GridGeometry;
     TSharedPtr<IPathfinder> Pathfinder;
 
+    UPROPERTY()
+    TArray<TObjectPtr<UHierarchicalInstancedStaticMeshComponent>> TileInstances;
+
     UPROPERTY()
     UClass* TileActorClass;
 
@@ -95,8 +152,5 @@ private:
     UPROPERTY()
     UGridSpatialPartition* SpatialPartition;
 
-    UPROPERTY()
-    TMap<ABallAgent*, FIntPoint> AgentToPreviousCellMap;
-
     FVector GridOrigin;
 };
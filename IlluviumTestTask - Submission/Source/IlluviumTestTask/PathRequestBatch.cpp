@@ -0,0 +1,83 @@
+#include "PathRequestBatch.h"
+#include "Async/TaskGraphInterfaces.h"
+
+void FPathRequestBatch::Submit(
+    IPathfinder& Pathfinder,
+    const IGridGeometry& Geometry,
+    const FGridLayers& Layers,
+    int32 NumTasks)
+{
+    check(!bInFlight);
+
+    Results.SetNum(Requests.Num(), EAllowShrinking::No);
+    Tasks.Reset();
+    bInFlight = true;
+
+    const int32 NumRequests = Requests.Num();
+    if (NumRequests == 0)
+        return;
+
+    if (NumTasks <= 0)
+    {
+        NumTasks = FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1);
+    }
+
+    // Pathfinders that keep state between queries have to be asked one at a time
+    if (!Pathfinder.SupportsConcurrentQueries())
+    {
+        NumTasks = 1;
+    }
+
+    NumTasks = FMath::Min(NumTasks, NumRequests);
+
+    for (int32 Task = 0; Task < NumTasks; ++Task)
+    {
+        const int32 Begin = static_cast<int32>(static_cast<int64>(NumRequests) * Task / NumTasks);
+        const int32 End = static_cast<int32>(static_cast<int64>(NumRequests) * (Task + 1) / NumTasks);
+
+        Tasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, &Pathfinder, &Geometry, &Layers, Begin, End]()
+        {
+            for (int32 Index = Begin; Index < End; ++Index)
+            {
+                const FPathRequest& Request = Requests[Index];
+
+                FPathBlockers Blockers(Layers);
+                Blockers.IgnoreOccupant(Request.Start).IgnoreOccupant(Request.Goal);
+
+                Results[Index] = Pathfinder.FindAgentPath(
+                    Request.AgentId,
+                    Request.Start,
+                    Request.Goal,
+                    Geometry,
+                    &Request.PreviousCell,
+                    &Blockers);
+            }
+        }));
+    }
+}
+
+bool FPathRequestBatch::IsComplete() const
+{
+    for (const UE::Tasks::FTask& Task : Tasks)
+    {
+        if (!Task.IsCompleted())
+            return false;
+    }
+
+    return true;
+}
+
+bool FPathRequestBatch::Wait(FTimespan Timeout) const
+{
+    return Tasks.IsEmpty() || UE::Tasks::Wait(Tasks, Timeout);
+}
+
+void FPathRequestBatch::Reset()
+{
+    Wait();
+
+    Requests.Reset();
+    Results.Reset();
+    Tasks.Reset();
+    bInFlight = false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathfinder.h"
+#include "Tasks/Task.h"
+
+/*
+====================================================================================
+  FPathRequestBatch - One step's path requests, searched on worker threads
+====================================================================================
+
+- AddRequest() collects a step's path requests and Submit() returns at once; the
+  searches run as UE::Tasks, one per contiguous range of requests.
+- Each request writes only its own result slot, so results come back in request
+  order whatever the number of tasks or the order they finish in.
+- A request is blocked by everything the layers block except the occupants of its
+  own start and goal cells, i.e. the searching agent and its target.
+- Wait() takes a timeout, so a caller with a frame to finish can give late results
+  a budget and come back for them on the next frame.
+
+Notes:
+- The pathfinder, geometry and layers are read until the batch completes and must not
+  change meanwhile; in particular no OnCellOccupancyChanged() may reach the pathfinder.
+- Pathfinders without concurrent query support get a single task, which still keeps
+  the searches off the submitting thread.
+*/
+
+struct FPathRequest
+{
+    int32 AgentId = INDEX_NONE;
+    FIntPoint Start;
+    FIntPoint Goal;
+
+    // Where the agent came from, passed to the pathfinder as PreviousCellBias
+    FIntPoint PreviousCell;
+};
+
+class FPathRequestBatch
+{
+public:
+    FPathRequestBatch() = default;
+    FPathRequestBatch(const FPathRequestBatch&) = delete;
+    FPathRequestBatch& operator=(const FPathRequestBatch&) = delete;
+
+    // The tasks write into this batch, so they are finished before it goes away
+    ~FPathRequestBatch() { Wait(); }
+
+    // Queues a request for the next Submit(); only between Reset() and Submit()
+    void AddRequest(const FPathRequest& Request)
+    {
+        check(!bInFlight);
+        Requests.Add(Request);
+    }
+
+    // Starts the searches for the requests added since Reset(). NumTasks of 0 uses one task
+    // per task graph worker.
+    void Submit(
+        IPathfinder& Pathfinder,
+        const IGridGeometry& Geometry,
+        const FGridLayers& Layers,
+        int32 NumTasks = 0);
+
+    // Submitted and not reset yet, whether the searches are done or not
+    bool IsInFlight() const { return bInFlight; }
+
+    bool IsComplete() const;
+
+    // Blocks until every search is done or Timeout has passed; returns whether they are all done.
+    // Waiting without a timeout may run searches not started yet on the calling thread.
+    bool Wait(FTimespan Timeout = FTimespan::MaxValue()) const;
+
+    // Only valid once complete. GetResults()[i] is the path for GetRequests()[i], empty if none was found.
+    TConstArrayView<FPathRequest> GetRequests() const { return Requests; }
+    TConstArrayView<TArray<FIntPoint>> GetResults() const { return Results; }
+
+    // Drops the requests and results, keeping the arrays' allocations for the next Submit(); waits for the searches first
+    void Reset();
+
+private:
+    TArray<FPathRequest> Requests;
+    TArray<TArray<FIntPoint>> Results;
+    TArray<UE::Tasks::FTask> Tasks;
+    bool bInFlight = false;
+};
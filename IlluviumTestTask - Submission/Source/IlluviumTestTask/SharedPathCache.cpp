@@ -0,0 +1,224 @@
+#include "SharedPathCache.h"
+
+FSharedPathCache::FSharedPathCache(int32 InMaxEntries)
+    : MaxEntries(FMath::Max(1, InMaxEntries))
+{
+}
+
+TArray<FIntPoint> FSharedPathCache::FindPath(
+    const FIntPoint& Start,
+    const FIntPoint& Goal,
+    const IGridGeometry& Geometry,
+    const FIntPoint* PreviousCellBias,
+    const FPathBlockers* Blockers)
+{
+    if (Geometry.GetGridSize() != GridSize)
+    {
+        GridSize = Geometry.GetGridSize();
+        Clear();
+    }
+
+    if (!IsInGrid(Start) || !IsInGrid(Goal))
+    {
+        return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    const int32 GoalIndex = Goal.Y * GridSize + Goal.X;
+    const int32 PreviousIndex = (PreviousCellBias && IsInGrid(*PreviousCellBias))
+        ? PreviousCellBias->Y * GridSize + PreviousCellBias->X
+        : INDEX_NONE;
+
+    TArray<FIntPoint> Path;
+
+    if (FEntry* Entry = Entries.FindByPredicate([GoalIndex](const FEntry& E) { return E.GoalIndex == GoalIndex; }))
+    {
+        if (TryGetCachedPath(*Entry, Start, Geometry, PreviousIndex, Blockers, Path))
+        {
+            ++Hits;
+            Entry->LastUsed = ++UseCounter;
+            return Path;
+        }
+    }
+
+    ++Misses;
+
+    // Search from the goal so that every closed cell ends up pointing towards it
+    FAStarScratch& Scratch = AStarPathfinder::GetThreadScratch();
+    if (!AStarPathfinder::Search(Goal, Start, Geometry, nullptr, Blockers, Scratch))
+    {
+        return {};
+    }
+
+    FEntry& Entry = AcquireEntry(GoalIndex);
+    Entry.BuiltAtChange = ChangeCounter;
+    Entry.LastUsed = ++UseCounter;
+    Entry.Tree.Reset();
+    Entry.Tree.Reserve(Scratch.ClosedCells.Num());
+
+    for (int32 Index : Scratch.ClosedCells)
+    {
+        Entry.Tree.Add(Index, FTreeNode{ Scratch.GetCameFrom(Index), Scratch.GetCost(Index) });
+    }
+
+    int32 Index = Start.Y * GridSize + Start.X;
+    Path.Add(Start);
+    while (Scratch.GetCameFrom(Index) != Index)
+    {
+        Index = Scratch.GetCameFrom(Index);
+        Path.Add(ToCell(Index));
+    }
+
+    // The tree is shared, so it is built without the requester's bias. Fall back to a regular
+    // search when that would send this agent straight back to its previous cell.
+    if (PreviousIndex != INDEX_NONE && Path.Num() > 1 && Path[1] == *PreviousCellBias)
+    {
+        return Fallback.FindPath(Start, Goal, Geometry, PreviousCellBias, Blockers);
+    }
+
+    return Path;
+}
+
+bool FSharedPathCache::TryGetCachedPath(
+    const FEntry& Entry,
+    const FIntPoint& Start,
+    const IGridGeometry& Geometry,
+    int32 PreviousIndex,
+    const FPathBlockers* Blockers,
+    TArray<FIntPoint>& OutPath)
+{
+    int32 Index = Start.Y * GridSize + Start.X;
+    OutPath.Reset();
+    OutPath.Add(Start);
+
+    // The start cell is usually occupied by the requesting agent itself and therefore was blocked when
+    // the tree was built - join the tree through the neighbour closest to the goal instead. Neighbours
+    // this request may not enter are skipped, so another one can still join the cached route.
+    if (!Entry.Tree.Contains(Index))
+    {
+        int32 BestIndex = INDEX_NONE;
+        float BestCost = TNumericLimits<float>::Max();
+        bool bSkippedInvalid = false;
+
+        for (const FIntPoint& Neighbor : Geometry.GetNeighbors(Start))
+        {
+            if (!IsInGrid(Neighbor))
+                continue;
+
+            const int32 NeighborIndex = Neighbor.Y * GridSize + Neighbor.X;
+            if (NeighborIndex == PreviousIndex)
+                continue;
+
+            const FTreeNode* Node = Entry.Tree.Find(NeighborIndex);
+            if (!Node)
+                continue;
+
+            if (NeighborIndex != Entry.GoalIndex && !IsRouteCellValid(Entry, NeighborIndex, Blockers))
+            {
+                bSkippedInvalid = true;
+                continue;
+            }
+
+            // Cost of the whole route through this neighbour, the step onto it included
+            const float Cost = Node->Cost + 1.0f;
+            if (Cost < BestCost)
+            {
+                BestCost = Cost;
+                BestIndex = NeighborIndex;
+            }
+        }
+
+        if (BestIndex == INDEX_NONE)
+        {
+            if (bSkippedInvalid)
+            {
+                ++Invalidations;
+            }
+
+            return false;
+        }
+
+        Index = BestIndex;
+        OutPath.Add(ToCell(Index));
+    }
+    else if (Index != Entry.GoalIndex && Entry.Tree[Index].Next == PreviousIndex)
+    {
+        return false;
+    }
+
+    while (Index != Entry.GoalIndex)
+    {
+        const FTreeNode* Node = Entry.Tree.Find(Index);
+        if (!Node)
+            return false;
+
+        Index = Node->Next;
+        if (Index != Entry.GoalIndex && !IsRouteCellValid(Entry, Index, Blockers))
+        {
+            ++Invalidations;
+            return false;
+        }
+
+        OutPath.Add(ToCell(Index));
+    }
+
+    return true;
+}
+
+bool FSharedPathCache::IsRouteCellValid(const FEntry& Entry, int32 Index, const FPathBlockers* Blockers) const
+{
+    if (CellChangedAt[Index] > Entry.BuiltAtChange)
+        return false;
+
+    return !Blockers || !Blockers->IsBlocked(ToCell(Index));
+}
+
+FSharedPathCache::FEntry& FSharedPathCache::AcquireEntry(int32 GoalIndex)
+{
+    if (FEntry* Existing = Entries.FindByPredicate([GoalIndex](const FEntry& E) { return E.GoalIndex == GoalIndex; }))
+    {
+        return *Existing;
+    }
+
+    if (Entries.Num() < MaxEntries)
+    {
+        FEntry& Entry = Entries.AddDefaulted_GetRef();
+        Entry.GoalIndex = GoalIndex;
+        return Entry;
+    }
+
+    // Reuse the least recently used entry, keeping its tree allocation
+    FEntry* Oldest = &Entries[0];
+    for (FEntry& Entry : Entries)
+    {
+        if (Entry.LastUsed < Oldest->LastUsed)
+        {
+            Oldest = &Entry;
+        }
+    }
+
+    Oldest->GoalIndex = GoalIndex;
+    return *Oldest;
+}
+
+void FSharedPathCache::OnCellOccupancyChanged(const FIntPoint& Cell)
+{
+    if (!IsInGrid(Cell))
+        return;
+
+    if (++ChangeCounter == 0)
+    {
+        // Stamps can no longer be ordered against the entries, start over
+        Clear();
+        ChangeCounter = 1;
+    }
+
+    CellChangedAt[Cell.Y * GridSize + Cell.X] = ChangeCounter;
+}
+
+void FSharedPathCache::Clear()
+{
+    Entries.Reset();
+    CellChangedAt.Reset();
+    CellChangedAt.SetNumZeroed(GridSize * GridSize);
+    ChangeCounter = 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathfinder.h"
+#include "AStarPathfinder.h"
+
+/*
+====================================================================================
+  FSharedPathCache - Path reuse between agents chasing the same target
+====================================================================================
+
+- On a miss the search runs from the goal towards the requesting agent, and every
+  closed cell is stored with its next step towards the goal and its distance to it.
+  That tree is kept per goal cell for the MaxEntries most recently used goals.
+- A later request for the same goal is answered from the tree when the start cell,
+  or one of its neighbours, is part of it - no new search is needed.
+- Occupancy changes reported through OnCellOccupancyChanged() stamp the cell, and a
+  cached route crossing a cell stamped after its tree was built (or a cell blocked
+  for the current request) counts as invalidated and is searched again.
+
+Notes:
+- Not thread-safe; meant to be used from the simulation step only.
+*/
+
+class FSharedPathCache : public IPathfinder
+{
+public:
+    explicit FSharedPathCache(int32 InMaxEntries = 16);
+
+    virtual TArray<FIntPoint> FindPath(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const FIntPoint* PreviousCellBias = nullptr,
+        const FPathBlockers* Blockers = nullptr) override;
+
+    virtual void OnCellOccupancyChanged(const FIntPoint& Cell) override;
+
+    void Clear();
+
+    int32 GetHits() const { return Hits; }
+    int32 GetMisses() const { return Misses; }
+    int32 GetInvalidations() const { return Invalidations; }
+
+private:
+    struct FTreeNode
+    {
+        int32 Next;
+        float Cost;
+    };
+
+    struct FEntry
+    {
+        int32 GoalIndex = INDEX_NONE;
+        uint32 BuiltAtChange = 0;
+        uint64 LastUsed = 0;
+        TMap<int32, FTreeNode> Tree;
+    };
+
+    bool TryGetCachedPath(
+        const FEntry& Entry,
+        const FIntPoint& Start,
+        const IGridGeometry& Geometry,
+        int32 PreviousIndex,
+        const FPathBlockers* Blockers,
+        TArray<FIntPoint>& OutPath);
+
+    bool IsRouteCellValid(const FEntry& Entry, int32 Index, const FPathBlockers* Blockers) const;
+
+    FEntry& AcquireEntry(int32 GoalIndex);
+
+    bool IsInGrid(const FIntPoint& Cell) const
+    {
+        return Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize;
+    }
+
+    FIntPoint ToCell(int32 Index) const { return FIntPoint(Index % GridSize, Index / GridSize); }
+
+    TArray<FEntry> Entries;
+
+    // Value of ChangeCounter when each cell last changed occupancy
+    TArray<uint32> CellChangedAt;
+    uint32 ChangeCounter = 0;
+    uint64 UseCounter = 0;
+
+    int32 GridSize = 0;
+    int32 MaxEntries = 16;
+
+    AStarPathfinder Fallback;
+
+    int32 Hits = 0;
+    int32 Misses = 0;
+    int32 Invalidations = 0;
+};
@@ -0,0 +1,950 @@
+#include "SimulationBenchmarks.h"
+#include "AStarPathfinder.h"
+#include "HierarchicalPathfinder.h"
+#include "JumpPointPathfinder.h"
+#include "IncrementalPathfinder.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+#include "MyGridManager.h"
+#include "SimulationSystem.h"
+#include "StepArena.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Crc.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Algo/Reverse.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+/*
+====================================================================================
+  Simulation Benchmarks - Development console commands
+====================================================================================
+
+Simulation.Benchmark.AStar [QueriesPerGrid]
+    - Runs the same random queries on 64, 256 and 1024 square grids (15% of the cells
+      blocked) through the hash-container A* the simulation used to ship with and
+      through AStarPathfinder, and logs the timings and any path mismatches. The same
+      queries also run through FJumpPointPathfinder, whose paths may differ from A*'s
+      but must be just as short.
+
+Simulation.Benchmark.ParallelStep [AgentsPerTeam] [Steps]
+    - Runs the same seeded headless battle on a 256 square grid with 1, 2, 4, 8, 16 and
+      32 decision workers, and logs the time per configuration together with a hash of
+      the final agent state, which has to be identical for every worker count.
+
+Simulation.Benchmark.Suite [Quick] [OutputPath]
+    - Measures GetCellsInRange, FindPath (open field, maze, unreachable goal; open field
+      and maze also through FHierarchicalPathfinder; on square grids a 20% cluttered
+      map, and open field, maze and clutter through FJumpPointPathfinder; an agent
+      replanning every step among moving obstacles, through A* and
+      FIncrementalPathfinder; on hex grids a wall crossable only diagonally, through
+      FHierarchicalPathfinder),
+      GetSurroundingAgents, FindNearestEnemy (what FindClosestEnemy runs), snapshot save
+      and restore, and AdvanceStep
+      on square and hex grids of 32 to 2048 cells per side with 10 to 100k agents.
+    - Every case reports ns/op, allocations/op, bytes allocated/op and the peak of
+      extra live heap memory, and the whole run is written out as JSON (see
+      SimulationBenchmarks::RunSuite()).
+    - Allocations are counted by a proxy in front of GMalloc, installed at start-up when
+      the command line has -BenchmarkAllocations. Only allocations made on the thread
+      running a case count, so work a case hands to task workers is not included, and
+      without the switch the allocation columns stay 0.
+    - Agent counts above a quarter of the cells are skipped, and so is A* movement
+      above 10k agents, where a single step takes minutes.
+*/
+
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+    // Reference copy of the original TSet/TMap based search, kept to measure against and to verify
+    // that AStarPathfinder returns identical paths. The only change is the grid bounds check, which
+    // the dense search needs in order to index its arrays.
+    TArray<FIntPoint> FindPathWithHashContainers(
+        const FIntPoint& Start,
+        const FIntPoint& Goal,
+        const IGridGeometry& Geometry,
+        const TSet<FIntPoint>* TempUnwalkable)
+    {
+        struct FNode
+        {
+            FIntPoint Coord;
+            float PathCost;
+
+            bool operator<(const FNode& Other) const
+            {
+                return PathCost < Other.PathCost;
+            }
+        };
+
+        const int32 GridSize = Geometry.GetGridSize();
+        const int32 MaxSteps = GridSize * GridSize;
+        int32 StepsTaken = 0;
+
+        TArray<FNode> Frontier;
+        TSet<FIntPoint> FrontierSet;
+        TSet<FIntPoint> ClosedSet;
+
+        TMap<FIntPoint, FIntPoint> CameFrom;
+        TMap<FIntPoint, float> CostSoFar;
+
+        Frontier.HeapPush(FNode{ Start, 0.0f });
+        FrontierSet.Add(Start);
+        CameFrom.Add(Start, Start);
+        CostSoFar.Add(Start, 0.0f);
+
+        while (!Frontier.IsEmpty())
+        {
+            if (++StepsTaken > MaxSteps)
+                return {};
+
+            FNode Current;
+            Frontier.HeapPop(Current);
+            FrontierSet.Remove(Current.Coord);
+
+            if (ClosedSet.Contains(Current.Coord))
+                continue;
+
+            ClosedSet.Add(Current.Coord);
+
+            if (Current.Coord == Goal)
+            {
+                TArray<FIntPoint> Path;
+                FIntPoint Step = Goal;
+                while (CameFrom[Step] != Step)
+                {
+                    Path.Add(Step);
+                    Step = CameFrom[Step];
+                }
+                Path.Add(Step);
+                Algo::Reverse(Path);
+                return Path;
+            }
+
+            const float CurrentCost = CostSoFar[Current.Coord];
+
+            for (const FIntPoint& Neighbor : Geometry.GetNeighbors(Current.Coord))
+            {
+                if (Neighbor.X < 0 || Neighbor.X >= GridSize || Neighbor.Y < 0 || Neighbor.Y >= GridSize)
+                    continue;
+
+                if (TempUnwalkable && TempUnwalkable->Contains(Neighbor))
+                    continue;
+
+                if (ClosedSet.Contains(Neighbor))
+                    continue;
+
+                const float NewCost = CurrentCost + 1.0f;
+                float* ExistingCost = CostSoFar.Find(Neighbor);
+                if (!ExistingCost || NewCost < *ExistingCost)
+                {
+                    CostSoFar.Add(Neighbor, NewCost);
+                    CameFrom.Add(Neighbor, Current.Coord);
+
+                    if (!FrontierSet.Contains(Neighbor))
+                    {
+                        Frontier.HeapPush(FNode{ Neighbor, NewCost + Geometry.HeuristicDistance(Neighbor, Goal) });
+                        FrontierSet.Add(Neighbor);
+                    }
+                }
+            }
+        }
+
+        return {};
+    }
+
+    void RunAStarBenchmark(int32 GridSize, int32 NumQueries)
+    {
+        FSquareGrid Geometry(GridSize, 100.f);
+        FRandomStream RandomStream(GridSize);
+
+        TSet<FIntPoint> Blocked;
+        const int32 NumBlocked = GridSize * GridSize * 15 / 100;
+        while (Blocked.Num() < NumBlocked)
+        {
+            Blocked.Add(FIntPoint(RandomStream.RandRange(0, GridSize - 1), RandomStream.RandRange(0, GridSize - 1)));
+        }
+
+        auto RandomFreeCell = [&]()
+        {
+            FIntPoint Cell;
+            do
+            {
+                Cell = FIntPoint(RandomStream.RandRange(0, GridSize - 1), RandomStream.RandRange(0, GridSize - 1));
+            } while (Blocked.Contains(Cell));
+            return Cell;
+        };
+
+        // The same obstacles as static bits, for the pathfinders that take FPathBlockers
+        FGridLayers BlockedLayers;
+        BlockedLayers.Reset(GridSize);
+        for (const FIntPoint& Cell : Blocked)
+        {
+            BlockedLayers.Set(FGridLayers::ELayer::Static, Cell, true);
+        }
+        const FPathBlockers Blockers(BlockedLayers);
+
+        TArray<TPair<FIntPoint, FIntPoint>> Queries;
+        for (int32 i = 0; i < NumQueries; ++i)
+        {
+            Queries.Emplace(RandomFreeCell(), RandomFreeCell());
+        }
+
+        TArray<TArray<FIntPoint>> ReferencePaths;
+        ReferencePaths.SetNum(NumQueries);
+
+        double StartTime = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumQueries; ++i)
+        {
+            ReferencePaths[i] = FindPathWithHashContainers(Queries[i].Key, Queries[i].Value, Geometry, &Blocked);
+        }
+        const double ReferenceSeconds = FPlatformTime::Seconds() - StartTime;
+
+        AStarPathfinder Pathfinder;
+        int32 Mismatches = 0;
+
+        StartTime = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumQueries; ++i)
+        {
+            TArray<FIntPoint> Path = Pathfinder.FindPath(Queries[i].Key, Queries[i].Value, Geometry, nullptr, &Blockers);
+            if (Path != ReferencePaths[i])
+            {
+                ++Mismatches;
+            }
+        }
+        const double DenseSeconds = FPlatformTime::Seconds() - StartTime;
+
+        FJumpPointPathfinder JumpPointPathfinder;
+        int32 LengthMismatches = 0;
+
+        StartTime = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumQueries; ++i)
+        {
+            TArray<FIntPoint> Path = JumpPointPathfinder.FindPath(Queries[i].Key, Queries[i].Value, Geometry, nullptr, &Blockers);
+            if (Path.Num() != ReferencePaths[i].Num())
+            {
+                ++LengthMismatches;
+            }
+        }
+        const double JumpPointSeconds = FPlatformTime::Seconds() - StartTime;
+
+        UE_LOG(LogTemp, Display, TEXT("A* %4dx%-4d | %4d queries | hash containers %9.3f ms | dense %9.3f ms | speedup x%.2f | mismatches %d"),
+            GridSize, GridSize, NumQueries,
+            ReferenceSeconds * 1000.0, DenseSeconds * 1000.0,
+            DenseSeconds > 0.0 ? ReferenceSeconds / DenseSeconds : 0.0,
+            Mismatches);
+
+        UE_LOG(LogTemp, Display, TEXT("JPS %4dx%-4d | %4d queries | %9.3f ms | vs dense A* x%.2f | length mismatches %d"),
+            GridSize, GridSize, NumQueries,
+            JumpPointSeconds * 1000.0,
+            JumpPointSeconds > 0.0 ? DenseSeconds / JumpPointSeconds : 0.0,
+            LengthMismatches);
+    }
+
+    uint32 HashAgentStore(const FSimAgentStore& Agents)
+    {
+        uint32 Crc = 0;
+        Crc = FCrc::MemCrc32(Agents.HP.GetData(), Agents.HP.Num() * sizeof(int32), Crc);
+        Crc = FCrc::MemCrc32(Agents.Cell.GetData(), Agents.Cell.Num() * sizeof(FIntPoint), Crc);
+        Crc = FCrc::MemCrc32(Agents.State.GetData(), Agents.State.Num() * sizeof(EAgentState), Crc);
+        Crc = FCrc::MemCrc32(Agents.TargetId.GetData(), Agents.TargetId.Num() * sizeof(int32), Crc);
+        return Crc;
+    }
+
+    void RunParallelStepBenchmark(int32 AgentsPerTeam, int32 NumSteps)
+    {
+        const int32 GridSize = 256;
+        uint32 ReferenceHash = 0;
+        double ReferenceSeconds = 0.0;
+
+        for (int32 Workers : { 1, 2, 4, 8, 16, 32 })
+        {
+            UMyGridManager* GridManager = NewObject<UMyGridManager>();
+            GridManager->SetGridGeometry(MakeShared<FSquareGrid>(GridSize, 100.f));
+            GridManager->SetPathfinder(MakeShared<AStarPathfinder>());
+            GridManager->InitializeGrid(GridSize);
+
+            USimulationSystem* Simulation = NewObject<USimulationSystem>();
+            Simulation->SetDecisionWorkers(Workers);
+            Simulation->Initialize(GridSize, 0.1f, GridManager, AgentsPerTeam, nullptr);
+
+            const double StartTime = FPlatformTime::Seconds();
+            for (int32 Step = 0; Step < NumSteps && !Simulation->IsBattleOver(); ++Step)
+            {
+                Simulation->AdvanceStep();
+            }
+            const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+            const uint32 Hash = HashAgentStore(Simulation->GetAgents());
+            if (Workers == 1)
+            {
+                ReferenceHash = Hash;
+                ReferenceSeconds = Seconds;
+            }
+
+            UE_LOG(LogTemp, Display, TEXT("Step %2d workers | %5d agents | %4d steps | %9.3f ms | speedup x%.2f | state %08x %s"),
+                Workers, AgentsPerTeam * 2, Simulation->GetCurrentStep(),
+                Seconds * 1000.0,
+                Seconds > 0.0 ? ReferenceSeconds / Seconds : 0.0,
+                Hash,
+                Hash == ReferenceHash ? TEXT("matches") : TEXT("DIFFERS"));
+
+            Simulation->CleanUp();
+        }
+    }
+
+    // What FCountingMalloc counted on one thread since FScopedAllocationCounting last opened there
+    struct FThreadAllocationCounts
+    {
+        bool bCounting = false;
+
+        int64 NumAllocations = 0;
+        int64 BytesAllocated = 0;
+
+        // Relative to the scope's start, so memory freed that was allocated before it makes this negative
+        int64 LiveBytes = 0;
+        int64 PeakLiveBytes = 0;
+    };
+
+    thread_local FThreadAllocationCounts ThreadAllocationCounts;
+
+    // Forwards to the allocator it was created with, counting allocations and live bytes
+    // of the threads that are inside an FScopedAllocationCounting
+    class FCountingMalloc final : public FMalloc
+    {
+    public:
+        explicit FCountingMalloc(FMalloc* InInner)
+            : Inner(InInner)
+        {
+        }
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            void* Ptr = Inner->Malloc(Count, Alignment);
+            OnAllocated(Ptr, Count);
+            return Ptr;
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            const SIZE_T OldSize = SizeOf(Original);
+            void* Ptr = Inner->Realloc(Original, Count, Alignment);
+            OnFreed(OldSize);
+            OnAllocated(Ptr, Count);
+            return Ptr;
+        }
+
+        virtual void Free(void* Original) override
+        {
+            OnFreed(SizeOf(Original));
+            Inner->Free(Original);
+        }
+
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+        virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+        virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+        virtual void MarkTLSCachesAsUsedOnCurrentThread() override { Inner->MarkTLSCachesAsUsedOnCurrentThread(); }
+        virtual void MarkTLSCachesAsUnusedOnCurrentThread() override { Inner->MarkTLSCachesAsUnusedOnCurrentThread(); }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+        virtual void UpdateStats() override { Inner->UpdateStats(); }
+        virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+        virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+        virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+        virtual const TCHAR* GetDescriptiveName() override { return TEXT("BenchmarkCountingMalloc"); }
+
+    private:
+        // Usable size of an allocation, 0 when the inner allocator cannot tell
+        SIZE_T SizeOf(void* Ptr)
+        {
+            SIZE_T Size = 0;
+            return (Ptr && Inner->GetAllocationSize(Ptr, Size)) ? Size : 0;
+        }
+
+        void OnAllocated(void* Ptr, SIZE_T Count)
+        {
+            FThreadAllocationCounts& Counts = ThreadAllocationCounts;
+            if (!Counts.bCounting || !Ptr)
+                return;
+
+            const SIZE_T Usable = SizeOf(Ptr);
+            const int64 Size = static_cast<int64>(Usable > 0 ? Usable : Count);
+
+            ++Counts.NumAllocations;
+            Counts.BytesAllocated += Size;
+            Counts.LiveBytes += Size;
+            Counts.PeakLiveBytes = FMath::Max(Counts.PeakLiveBytes, Counts.LiveBytes);
+        }
+
+        void OnFreed(SIZE_T Size)
+        {
+            FThreadAllocationCounts& Counts = ThreadAllocationCounts;
+            if (Counts.bCounting)
+            {
+                Counts.LiveBytes -= static_cast<int64>(Size);
+            }
+        }
+
+        FMalloc* Inner;
+    };
+
+    // Set once by InstallAllocationCounter(), before the benchmarks can run
+    bool bAllocationCounterInstalled = false;
+
+    // Counts the calling thread's allocations while in scope; the counts stay readable after it closes
+    struct FScopedAllocationCounting
+    {
+        FScopedAllocationCounting()
+        {
+            ThreadAllocationCounts = FThreadAllocationCounts();
+            ThreadAllocationCounts.bCounting = true;
+        }
+
+        ~FScopedAllocationCounting()
+        {
+            ThreadAllocationCounts.bCounting = false;
+        }
+    };
+
+    struct FBenchmarkSettings
+    {
+        double SecondsPerCase = 0.5;
+        int64 MaxOpsPerCase = 100000;
+    };
+
+    struct FBenchmarkResult
+    {
+        FString Case;
+        FString Shape;
+        int32 GridSize = 0;
+        int32 NumAgents = 0;
+        int64 Ops = 0;
+        double NsPerOp = 0.0;
+        double AllocationsPerOp = 0.0;
+        double BytesPerOp = 0.0;
+        int64 PeakLiveBytes = 0;
+    };
+
+    // Calls Op(OpIndex) until MaxOpsPerCase calls or SecondsPerCase are used up, or until it
+    // returns false. Runs at least once. bWarmUp adds one untimed call first, so that
+    // per-thread scratch buffers are grown before counting starts.
+    template<typename OpType>
+    FBenchmarkResult Measure(const FBenchmarkSettings& Settings, bool bWarmUp, OpType&& Op)
+    {
+        if (bWarmUp)
+        {
+            Op(0);
+        }
+
+        FBenchmarkResult Result;
+        double Seconds = 0.0;
+
+        {
+            FScopedAllocationCounting Counting;
+            const double StartTime = FPlatformTime::Seconds();
+
+            while (Result.Ops < Settings.MaxOpsPerCase && Op(Result.Ops))
+            {
+                ++Result.Ops;
+
+                // Reading the clock costs about as much as the cheapest cases, so only every 16th op
+                // checks it once the case is known not to be slow
+                if ((Result.Ops < 16 || (Result.Ops & 15) == 0) && FPlatformTime::Seconds() - StartTime >= Settings.SecondsPerCase)
+                    break;
+            }
+
+            Seconds = FPlatformTime::Seconds() - StartTime;
+        }
+
+        if (Result.Ops > 0)
+        {
+            Result.NsPerOp = Seconds * 1e9 / Result.Ops;
+            Result.AllocationsPerOp = static_cast<double>(ThreadAllocationCounts.NumAllocations) / Result.Ops;
+            Result.BytesPerOp = static_cast<double>(ThreadAllocationCounts.BytesAllocated) / Result.Ops;
+        }
+        Result.PeakLiveBytes = ThreadAllocationCounts.PeakLiveBytes;
+
+        return Result;
+    }
+
+    template<typename GeometryType>
+    void RunGeometryBenchmarks(
+        const TCHAR* ShapeName,
+        int32 GridSize,
+        TConstArrayView<int32> AgentCounts,
+        const FBenchmarkSettings& Settings,
+        TArray<FBenchmarkResult>& OutResults)
+    {
+        TSharedPtr<GeometryType> Geometry = MakeShared<GeometryType>(GridSize, 100.f);
+        TAStarPathfinder<GeometryType> Pathfinder;
+        FRandomStream RandomStream(GridSize);
+
+        auto AddResult = [&](const TCHAR* Case, int32 NumAgents, FBenchmarkResult&& Result)
+        {
+            Result.Case = Case;
+            Result.Shape = ShapeName;
+            Result.GridSize = GridSize;
+            Result.NumAgents = NumAgents;
+
+            UE_LOG(LogTemp, Display, TEXT("%-22s %-6s %4d | %6d agents | %12.1f ns/op | %9.2f allocs/op | %11.1f bytes/op | peak %11lld bytes | %lld ops"),
+                Case, ShapeName, GridSize, NumAgents,
+                Result.NsPerOp, Result.AllocationsPerOp, Result.BytesPerOp,
+                Result.PeakLiveBytes, Result.Ops);
+
+            OutResults.Add(MoveTemp(Result));
+        };
+
+        // Query centres and path end points
+        TArray<FIntPoint> Cells;
+        for (int32 i = 0; i < 256; ++i)
+        {
+            Cells.Add(FIntPoint(RandomStream.RandRange(0, GridSize - 1), RandomStream.RandRange(0, GridSize - 1)));
+        }
+
+        AddResult(TEXT("GetCellsInRange"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            FStepArenaScope ArenaScope;
+            TStepArray<FIntPoint> CellsInRange;
+            Geometry->GetCellsInRange(Cells[static_cast<int32>(Op % Cells.Num())], 2, CellsInRange);
+            return true;
+        }));
+
+        AddResult(TEXT("FindPath/OpenField"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            Pathfinder.FindPath(Cells[static_cast<int32>(Op % Cells.Num())], Cells[static_cast<int32>((Op * 7 + 1) % Cells.Num())], *Geometry);
+            return true;
+        }));
+
+        // Serpentine maze: a wall on every fourth column, open alternately at the top and the bottom
+        FGridLayers Walls;
+        Walls.Reset(GridSize);
+        for (int32 X = 2; X < GridSize - 1; X += 4)
+        {
+            const int32 GapY = ((X / 4) % 2 == 0) ? GridSize - 1 : 0;
+            for (int32 Y = 0; Y < GridSize; ++Y)
+            {
+                if (Y != GapY)
+                {
+                    Walls.Set(FGridLayers::ELayer::Static, FIntPoint(X, Y), true);
+                }
+            }
+        }
+        const FPathBlockers WallBlockers(Walls);
+
+        AddResult(TEXT("FindPath/Maze"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            Pathfinder.FindPath(FIntPoint(0, 0), FIntPoint(GridSize - 1, GridSize - 1), *Geometry, nullptr, &WallBlockers);
+            return true;
+        }));
+
+        // Same queries through the abstract graph; walls are static obstacles there, built in up front
+        FHierarchicalPathfinder HierarchicalPathfinder;
+        HierarchicalPathfinder.Build(*Geometry);
+
+        AddResult(TEXT("FindPath/HPA/OpenField"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            HierarchicalPathfinder.FindPath(Cells[static_cast<int32>(Op % Cells.Num())], Cells[static_cast<int32>((Op * 7 + 1) % Cells.Num())], *Geometry);
+            return true;
+        }));
+
+        HierarchicalPathfinder.Build(*Geometry, &Walls);
+
+        AddResult(TEXT("FindPath/HPA/Maze"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            HierarchicalPathfinder.FindPath(FIntPoint(0, 0), FIntPoint(GridSize - 1, GridSize - 1), *Geometry);
+            return true;
+        }));
+
+        // A wall along the first cluster border that only hex cells can cross, diagonally: the last
+        // column of the west clusters is blocked on even rows, the first column of the east ones on odd rows
+        if constexpr (GeometryType::Shape == EGridShape::Hex)
+        {
+            const int32 BorderX = HierarchicalPathfinder.GetClusterSize();
+            if (BorderX < GridSize)
+            {
+                FGridLayers DiagonalWall;
+                DiagonalWall.Reset(GridSize);
+                for (int32 Y = 0; Y < GridSize; ++Y)
+                {
+                    DiagonalWall.Set(FGridLayers::ELayer::Static, FIntPoint(Y % 2 == 0 ? BorderX - 1 : BorderX, Y), true);
+                }
+
+                HierarchicalPathfinder.Build(*Geometry, &DiagonalWall);
+
+                if (HierarchicalPathfinder.FindPath(FIntPoint(0, 0), FIntPoint(GridSize - 1, GridSize - 1), *Geometry).IsEmpty())
+                {
+                    UE_LOG(LogTemp, Error, TEXT("HPA* %s %d found no path through a wall with diagonal gaps"), ShapeName, GridSize);
+                }
+
+                AddResult(TEXT("FindPath/HPA/DiagonalGaps"), 0, Measure(Settings, true, [&](int64 Op)
+                {
+                    HierarchicalPathfinder.FindPath(FIntPoint(0, 0), FIntPoint(GridSize - 1, GridSize - 1), *Geometry);
+                    return true;
+                }));
+            }
+        }
+
+        // One agent walking across the grid after a target that steps aside every fourth query,
+        // while two of the obstacles (5% of the cells) move to a neighbouring cell between queries
+        auto MeasureReplanning = [&](IPathfinder& ReplanPathfinder)
+        {
+            FRandomStream ReplanStream(GridSize);
+            FIntPoint Walker(0, 0);
+            FIntPoint Target(GridSize - 1, GridSize - 1);
+
+            TArray<FIntPoint> Obstacles;
+            FGridLayers Occupied;
+            Occupied.Reset(GridSize);
+            while (Obstacles.Num() < GridSize * GridSize / 20)
+            {
+                const FIntPoint Cell(ReplanStream.RandRange(0, GridSize - 1), ReplanStream.RandRange(0, GridSize - 1));
+                if (Cell != Walker && Cell != Target && !Occupied.IsOccupied(Cell))
+                {
+                    Occupied.Set(FGridLayers::ELayer::Occupancy, Cell, true);
+                    Obstacles.Add(Cell);
+                }
+            }
+
+            // Reads the layers as they change; nothing to ignore, the walker and target are never in them
+            const FPathBlockers Blockers(Occupied);
+
+            auto StepAside = [&](const FIntPoint& Cell)
+            {
+                const FGridNeighbors Neighbors = Geometry->GetNeighbors(Cell);
+                const FIntPoint Next = Neighbors[ReplanStream.RandRange(0, Neighbors.Num() - 1)];
+                const bool bFree = Next.X >= 0 && Next.X < GridSize && Next.Y >= 0 && Next.Y < GridSize
+                    && Next != Walker && Next != Target && !Occupied.IsOccupied(Next);
+                return bFree ? Next : Cell;
+            };
+
+            return Measure(Settings, true, [&](int64 Op)
+            {
+                for (int32 i = 0; i < 2; ++i)
+                {
+                    FIntPoint& Obstacle = Obstacles[ReplanStream.RandRange(0, Obstacles.Num() - 1)];
+                    const FIntPoint Next = StepAside(Obstacle);
+                    if (Next != Obstacle)
+                    {
+                        Occupied.Set(FGridLayers::ELayer::Occupancy, Obstacle, false);
+                        Occupied.Set(FGridLayers::ELayer::Occupancy, Next, true);
+                        ReplanPathfinder.OnCellOccupancyChanged(Obstacle);
+                        ReplanPathfinder.OnCellOccupancyChanged(Next);
+                        Obstacle = Next;
+                    }
+                }
+
+                if (Op % 4 == 3)
+                {
+                    Target = StepAside(Target);
+                }
+
+                const TArray<FIntPoint> Path = ReplanPathfinder.FindAgentPath(0, Walker, Target, *Geometry, nullptr, &Blockers);
+
+                // Start the walk over once it arrives or gets stuck
+                Walker = Path.Num() > 2 ? Path[1] : FIntPoint(0, 0);
+                return true;
+            });
+        };
+
+        TAStarPathfinder<GeometryType> ReplanAStar;
+        FIncrementalPathfinder IncrementalPathfinder;
+
+        // Boxed-in targets and walkers fail now and then, and every failure logs
+        const ELogVerbosity::Type ReplanVerbosity = LogTemp.GetVerbosity();
+        LogTemp.SetVerbosity(ELogVerbosity::Error);
+
+        AddResult(TEXT("FindPath/Replan"), 0, MeasureReplanning(ReplanAStar));
+        AddResult(TEXT("FindPath/DStar/Replan"), 0, MeasureReplanning(IncrementalPathfinder));
+
+        LogTemp.SetVerbosity(ReplanVerbosity);
+
+        if constexpr (GeometryType::Shape == EGridShape::Square)
+        {
+            FJumpPointPathfinder JumpPointPathfinder;
+
+            // 20% of the cells blocked at random, which leaves JPS few long jumps
+            FGridLayers Clutter;
+            Clutter.Reset(GridSize);
+            const int32 NumCluttered = GridSize * GridSize / 5;
+            for (int32 NumSet = 0; NumSet < NumCluttered;)
+            {
+                const FIntPoint Cell(RandomStream.RandRange(0, GridSize - 1), RandomStream.RandRange(0, GridSize - 1));
+                if (!Clutter.IsStaticBlocked(Cell))
+                {
+                    Clutter.Set(FGridLayers::ELayer::Static, Cell, true);
+                    ++NumSet;
+                }
+            }
+
+            for (const FIntPoint& Cell : Cells)
+            {
+                Clutter.Set(FGridLayers::ELayer::Static, Cell, false);
+            }
+            const FPathBlockers ClutterBlockers(Clutter);
+
+            AddResult(TEXT("FindPath/JPS/OpenField"), 0, Measure(Settings, true, [&](int64 Op)
+            {
+                JumpPointPathfinder.FindPath(Cells[static_cast<int32>(Op % Cells.Num())], Cells[static_cast<int32>((Op * 7 + 1) % Cells.Num())], *Geometry);
+                return true;
+            }));
+
+            AddResult(TEXT("FindPath/JPS/Maze"), 0, Measure(Settings, true, [&](int64 Op)
+            {
+                JumpPointPathfinder.FindPath(FIntPoint(0, 0), FIntPoint(GridSize - 1, GridSize - 1), *Geometry, nullptr, &WallBlockers);
+                return true;
+            }));
+
+            // Cluttered queries may well be unreachable, and every failure logs
+            const ELogVerbosity::Type ClutterVerbosity = LogTemp.GetVerbosity();
+            LogTemp.SetVerbosity(ELogVerbosity::Error);
+
+            AddResult(TEXT("FindPath/Cluttered"), 0, Measure(Settings, true, [&](int64 Op)
+            {
+                Pathfinder.FindPath(Cells[static_cast<int32>(Op % Cells.Num())], Cells[static_cast<int32>((Op * 7 + 1) % Cells.Num())], *Geometry, nullptr, &ClutterBlockers);
+                return true;
+            }));
+
+            AddResult(TEXT("FindPath/JPS/Cluttered"), 0, Measure(Settings, true, [&](int64 Op)
+            {
+                JumpPointPathfinder.FindPath(Cells[static_cast<int32>(Op % Cells.Num())], Cells[static_cast<int32>((Op * 7 + 1) % Cells.Num())], *Geometry, nullptr, &ClutterBlockers);
+                return true;
+            }));
+
+            LogTemp.SetVerbosity(ClutterVerbosity);
+        }
+
+        // Goal walled in by its own neighbours, so every search exhausts the grid
+        const FIntPoint EnclosedGoal(GridSize / 2, GridSize / 2);
+        FGridLayers Enclosure;
+        Enclosure.Reset(GridSize);
+        for (const FIntPoint& Neighbor : Geometry->GetNeighbors(EnclosedGoal))
+        {
+            Enclosure.Set(FGridLayers::ELayer::Static, Neighbor, true);
+        }
+        const FPathBlockers EnclosureBlockers(Enclosure);
+
+        // Every one of these searches logs a failure, which would otherwise dominate the output
+        const ELogVerbosity::Type PreviousVerbosity = LogTemp.GetVerbosity();
+        LogTemp.SetVerbosity(ELogVerbosity::Error);
+
+        AddResult(TEXT("FindPath/Unreachable"), 0, Measure(Settings, true, [&](int64 Op)
+        {
+            Pathfinder.FindPath(FIntPoint(0, 0), EnclosedGoal, *Geometry, nullptr, &EnclosureBlockers);
+            return true;
+        }));
+
+        LogTemp.SetVerbosity(PreviousVerbosity);
+
+        auto CreateSimulation = [&](int32 AgentsPerTeam, bool bUseFlowField, UMyGridManager*& OutGridManager)
+        {
+            UMyGridManager* GridManager = NewObject<UMyGridManager>();
+            GridManager->SetGridGeometry(Geometry);
+            GridManager->SetPathfinder(MakeShared<TAStarPathfinder<GeometryType>>());
+            GridManager->InitializeGrid(GridSize);
+
+            USimulationSystem* Simulation = NewObject<USimulationSystem>();
+            Simulation->SetUseFlowField(bUseFlowField);
+            Simulation->SetDecisionWorkers(0);
+            Simulation->Initialize(GridSize, 0.1f, GridManager, AgentsPerTeam, nullptr);
+
+            OutGridManager = GridManager;
+            return Simulation;
+        };
+
+        for (int32 RequestedAgents : AgentCounts)
+        {
+            if (RequestedAgents > GridSize * GridSize / 4)
+                continue;
+
+            const int32 AgentsPerTeam = FMath::Max(RequestedAgents / 2, 1);
+            const int32 NumAgents = AgentsPerTeam * 2;
+
+            {
+                UMyGridManager* GridManager = nullptr;
+                USimulationSystem* Simulation = CreateSimulation(AgentsPerTeam, true, GridManager);
+                const FSimAgentStore& Agents = Simulation->GetAgents();
+
+                AddResult(TEXT("GetSurroundingAgents"), NumAgents, Measure(Settings, true, [&](int64 Op)
+                {
+                    FStepArenaScope ArenaScope;
+                    TStepArray<int32> SurroundingAgents;
+                    GridManager->GetSurroundingAgents(Agents.Cell[static_cast<int32>(Op % Agents.Num())], 2, SurroundingAgents);
+                    return true;
+                }));
+
+                AddResult(TEXT("FindClosestEnemy"), NumAgents, Measure(Settings, true, [&](int64 Op)
+                {
+                    const int32 SeekerId = static_cast<int32>(Op % Agents.Num());
+                    GridManager->FindNearestEnemy(Agents.Cell[SeekerId], Agents.Team[SeekerId], GridSize);
+                    return true;
+                }));
+
+                TArray<uint8> Snapshot;
+                AddResult(TEXT("SaveSnapshot"), NumAgents, Measure(Settings, true, [&](int64 Op)
+                {
+                    Simulation->SaveSnapshot(Snapshot);
+                    return true;
+                }));
+
+                AddResult(TEXT("RestoreSnapshot"), NumAgents, Measure(Settings, true, [&](int64 Op)
+                {
+                    return Simulation->RestoreSnapshot(Snapshot);
+                }));
+
+                Simulation->CleanUp();
+            }
+
+            for (bool bUseFlowField : { false, true })
+            {
+                if (!bUseFlowField && NumAgents > 10000)
+                    continue;
+
+                UMyGridManager* GridManager = nullptr;
+                USimulationSystem* Simulation = CreateSimulation(AgentsPerTeam, bUseFlowField, GridManager);
+
+                AddResult(bUseFlowField ? TEXT("AdvanceStep/FlowField") : TEXT("AdvanceStep/AStar"), NumAgents, Measure(Settings, false, [&](int64 Op)
+                {
+                    if (Simulation->IsBattleOver())
+                        return false;
+
+                    Simulation->AdvanceStep();
+                    return true;
+                }));
+
+                Simulation->CleanUp();
+            }
+        }
+    }
+
+    FString ResultsToJson(const TArray<FBenchmarkResult>& Results, bool bQuick)
+    {
+        FString Json = TEXT("{\n");
+        Json += FString::Printf(TEXT("  \"timestamp\": \"%s\",\n"), *FDateTime::UtcNow().ToIso8601());
+        Json += FString::Printf(TEXT("  \"configuration\": \"%s\",\n"), LexToString(FApp::GetBuildConfiguration()));
+        Json += FString::Printf(TEXT("  \"platform\": \"%s\",\n"), ANSI_TO_TCHAR(FPlatformProperties::IniPlatformName()));
+        Json += FString::Printf(TEXT("  \"cores\": %d,\n"), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+        Json += FString::Printf(TEXT("  \"quick\": %s,\n"), bQuick ? TEXT("true") : TEXT("false"));
+        Json += FString::Printf(TEXT("  \"allocations_counted\": %s,\n"), bAllocationCounterInstalled ? TEXT("true") : TEXT("false"));
+        Json += FString::Printf(TEXT("  \"process_peak_used_physical_bytes\": %llu,\n"), static_cast<uint64>(FPlatformMemory::GetStats().PeakUsedPhysical));
+        Json += TEXT("  \"results\": [\n");
+
+        for (int32 i = 0; i < Results.Num(); ++i)
+        {
+            const FBenchmarkResult& Result = Results[i];
+            Json += FString::Printf(
+                TEXT("    { \"case\": \"%s\", \"shape\": \"%s\", \"grid_size\": %d, \"agents\": %d, \"ops\": %lld, ")
+                TEXT("\"ns_per_op\": %.1f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f, \"peak_live_bytes\": %lld }%s\n"),
+                *Result.Case, *Result.Shape, Result.GridSize, Result.NumAgents, Result.Ops,
+                Result.NsPerOp, Result.AllocationsPerOp, Result.BytesPerOp, Result.PeakLiveBytes,
+                i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+        }
+
+        Json += TEXT("  ]\n}\n");
+        return Json;
+    }
+}
+
+void SimulationBenchmarks::InstallAllocationCounter()
+{
+    if (bAllocationCounterInstalled || !FParse::Param(FCommandLine::Get(), TEXT("BenchmarkAllocations")))
+        return;
+
+    // Never removed, so nothing can be freed through an allocator that is gone
+    static FCountingMalloc Counter(GMalloc);
+    GMalloc = &Counter;
+    FPlatformMisc::MemoryBarrier();
+
+    bAllocationCounterInstalled = true;
+}
+
+bool SimulationBenchmarks::RunSuite(bool bQuick, const FString& OutputPath)
+{
+    if (!bAllocationCounterInstalled)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Allocations are not counted; start with -BenchmarkAllocations to measure them"));
+    }
+
+    FBenchmarkSettings Settings;
+    Settings.SecondsPerCase = bQuick ? 0.1 : 0.5;
+
+    const TArray<int32> GridSizes = bQuick ? TArray<int32>{ 32, 128, 512 } : TArray<int32>{ 32, 128, 512, 2048 };
+    const TArray<int32> AgentCounts = bQuick ? TArray<int32>{ 10, 100, 1000 } : TArray<int32>{ 10, 100, 1000, 10000, 100000 };
+
+    TArray<FBenchmarkResult> Results;
+    for (int32 GridSize : GridSizes)
+    {
+        RunGeometryBenchmarks<FSquareGrid>(TEXT("Square"), GridSize, AgentCounts, Settings, Results);
+        RunGeometryBenchmarks<FHexGrid>(TEXT("Hex"), GridSize, AgentCounts, Settings, Results);
+    }
+
+    const FString Path = !OutputPath.IsEmpty()
+        ? OutputPath
+        : FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("SimulationBenchmarks-%s.json"), *FDateTime::Now().ToString());
+
+    if (!FFileHelper::SaveStringToFile(ResultsToJson(Results, bQuick), *Path))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Could not write benchmark results to %s"), *Path);
+        return false;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Wrote %d benchmark results to %s"), Results.Num(), *Path);
+    return true;
+}
+
+namespace
+{
+    FAutoConsoleCommand BenchmarkAStarCommand(
+        TEXT("Simulation.Benchmark.AStar"),
+        TEXT("Compares AStarPathfinder against the original hash-container search on 64, 256 and 1024 grids. Optional arg: queries per grid."),
+        FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+        {
+            const int32 Queries = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+
+            RunAStarBenchmark(64, Queries > 0 ? Queries : 500);
+            RunAStarBenchmark(256, Queries > 0 ? Queries : 100);
+            RunAStarBenchmark(1024, Queries > 0 ? Queries : 10);
+        }));
+
+    FAutoConsoleCommand BenchmarkParallelStepCommand(
+        TEXT("Simulation.Benchmark.ParallelStep"),
+        TEXT("Runs one headless battle with 1 to 32 decision workers and checks that all of them end in the same state. Optional args: agents per team, steps."),
+        FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+        {
+            const int32 AgentsPerTeam = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+            const int32 Steps = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+
+            RunParallelStepBenchmark(AgentsPerTeam > 0 ? AgentsPerTeam : 2000, Steps > 0 ? Steps : 200);
+        }));
+
+    FAutoConsoleCommand BenchmarkSuiteCommand(
+        TEXT("Simulation.Benchmark.Suite"),
+        TEXT("Runs the grid, pathfinding and step microbenchmarks and writes the results as JSON. Optional args: Quick, output file path."),
+        FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+        {
+            bool bQuick = false;
+            FString OutputPath;
+
+            for (const FString& Arg : Args)
+            {
+                if (Arg.Equals(TEXT("Quick"), ESearchCase::IgnoreCase))
+                {
+                    bQuick = true;
+                }
+                else
+                {
+                    OutputPath = Arg;
+                }
+            }
+
+            SimulationBenchmarks::RunSuite(bQuick, OutputPath);
+        }));
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+====================================================================================
+  SimulationBenchmarks - Benchmark suite entry point
+====================================================================================
+
+- Runs the microbenchmarks of SimulationBenchmarks.cpp: grid queries, spatial
+  partition lookups, path searches and full simulation steps, on square and hex grids.
+- Reachable from the console (Simulation.Benchmark.Suite) and from the headless
+  commandlet (-run=Simulation -Benchmark), so it can run on a build machine.
+- Not compiled into shipping builds.
+*/
+
+#if !UE_BUILD_SHIPPING
+
+namespace SimulationBenchmarks
+{
+    // Runs every case and writes the results as JSON to OutputPath, or to
+    // Saved/Benchmarks/ when it is empty. Quick limits grid sizes to 512 and agent
+    // counts to 1000. Returns false if the results could not be written.
+    bool RunSuite(bool bQuick, const FString& OutputPath = FString());
+
+    // Puts the allocation counting proxy in front of GMalloc when the command line has
+    // -BenchmarkAllocations. Called once from module start-up, before other threads
+    // allocate much, since GMalloc cannot be swapped safely while they do.
+    void InstallAllocationCounter();
+}
+
+#endif
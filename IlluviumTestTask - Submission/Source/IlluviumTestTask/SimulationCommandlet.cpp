@@ -0,0 +1,183 @@
+#include "SimulationCommandlet.h"
+#include "SimulationBenchmarks.h"
+#include "SimulationReplay.h"
+#include "SimulationSystem.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/Paths.h"
+
+USimulationCommandlet::USimulationCommandlet()
+{
+    IsClient = false;
+    IsServer = false;
+    IsEditor = false;
+    LogToConsole = true;
+}
+
+int32 USimulationCommandlet::Main(const FString& Params)
+{
+#if !UE_BUILD_SHIPPING
+    if (FParse::Param(*Params, TEXT("Benchmark")))
+    {
+        FString OutputPath;
+        FParse::Value(*Params, TEXT("Output="), OutputPath);
+        return SimulationBenchmarks::RunSuite(FParse::Param(*Params, TEXT("Quick")), OutputPath) ? 0 : 1;
+    }
+#endif
+
+    int32 NumWorkers = 1;
+    FParse::Value(*Params, TEXT("Workers="), NumWorkers);
+
+    FString ReplayPath;
+    if (FParse::Value(*Params, TEXT("Replay="), ReplayPath))
+    {
+        FSimulationReplay Replay;
+        if (!Replay.LoadFromFile(ReplayPath))
+            return 1;
+
+        const double StartTime = FPlatformTime::Seconds();
+        const FReplayVerifyResult Verification = Replay.Verify(NumWorkers);
+        const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+        if (Verification.Status == FReplayVerifyResult::EStatus::SetupFailed)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Replay %s (seed %d) could not be run"), *ReplayPath, Replay.Config.Seed);
+            return 1;
+        }
+
+        if (Verification.Status == FReplayVerifyResult::EStatus::Diverged)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Replay %s (seed %d) diverged at step %d of %d"),
+                *ReplayPath, Replay.Config.Seed, Verification.FirstMismatch, Replay.StepHashes.Num() - 1);
+            return 1;
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("Replay %s (seed %d) matched all %d steps, %.2f ms"),
+            *ReplayPath, Replay.Config.Seed, Replay.StepHashes.Num() - 1, ElapsedMs);
+        return 0;
+    }
+
+    FSimulationRunConfig Config;
+    int32 MaxSteps = 100000;
+    int32 NumRuns = 1;
+    FString GridType = TEXT("Square");
+    FString RecordPath;
+    FString PathfinderType = TEXT("AStar");
+
+    FParse::Value(*Params, TEXT("Seed="), Config.Seed);
+    FParse::Value(*Params, TEXT("AgentsPerTeam="), Config.AgentsPerTeam);
+    FParse::Value(*Params, TEXT("GridSize="), Config.GridSize);
+    FParse::Value(*Params, TEXT("TileSize="), Config.TileSize);
+    FParse::Value(*Params, TEXT("StepInterval="), Config.StepInterval);
+    FParse::Value(*Params, TEXT("MaxSteps="), MaxSteps);
+    FParse::Value(*Params, TEXT("Runs="), NumRuns);
+    FParse::Value(*Params, TEXT("GridType="), GridType);
+    FParse::Value(*Params, TEXT("AgentClass="), Config.AgentClassPath);
+    FParse::Value(*Params, TEXT("Record="), RecordPath);
+    FParse::Value(*Params, TEXT("Pathfinder="), PathfinderType);
+    FParse::Value(*Params, TEXT("ClusterSize="), Config.HierarchicalClusterSize);
+    Config.Shape = GridType.Equals(TEXT("Hex"), ESearchCase::IgnoreCase) ? EGridShape::Hex : EGridShape::Square;
+    Config.bUseFlowField = FParse::Param(*Params, TEXT("FlowField"));
+    Config.bSharePaths = FParse::Param(*Params, TEXT("SharePaths"));
+    if (PathfinderType.Equals(TEXT("Hierarchical"), ESearchCase::IgnoreCase))
+    {
+        Config.PathfinderType = EPathfinderType::Hierarchical;
+    }
+    else if (PathfinderType.Equals(TEXT("JumpPoint"), ESearchCase::IgnoreCase))
+    {
+        Config.PathfinderType = EPathfinderType::JumpPoint;
+    }
+    else if (PathfinderType.Equals(TEXT("Incremental"), ESearchCase::IgnoreCase))
+    {
+        Config.PathfinderType = EPathfinderType::Incremental;
+    }
+
+    if (Config.GridSize <= 0 || Config.AgentsPerTeam <= 0 || Config.StepInterval <= 0.f)
+    {
+        UE_LOG(LogTemp, Error, TEXT("GridSize, AgentsPerTeam and StepInterval must be positive."));
+        return 1;
+    }
+
+    const int32 BaseSeed = Config.Seed;
+
+    for (int32 Run = 0; Run < NumRuns; ++Run)
+    {
+        Config.Seed = BaseSeed + Run;
+
+        const double StartTime = FPlatformTime::Seconds();
+
+        USimulationSystem* Simulation = Config.CreateHeadlessSimulation(NumWorkers);
+        if (!Simulation)
+            return 1;
+
+        FSimulationReplay Replay;
+        const bool bRecord = !RecordPath.IsEmpty();
+        if (bRecord)
+        {
+            Replay.Reset(Config);
+            Replay.RecordStep(*Simulation);
+        }
+
+        // Set by the step that ends the battle; stays unset if MaxSteps runs out first
+        TOptional<FBattleResult> BattleResult;
+        Simulation->OnBattleFinished().AddLambda([&BattleResult](const FBattleResult& Result)
+        {
+            BattleResult = Result;
+        });
+
+        // Over as soon as it was spawned, reported before anything could bind
+        if (Simulation->IsBattleOver())
+        {
+            BattleResult = Simulation->GetBattleResult();
+        }
+
+        while (!Simulation->IsBattleOver() && Simulation->GetCurrentStep() < MaxSteps)
+        {
+            Simulation->AdvanceStep();
+
+            if (bRecord)
+            {
+                Replay.RecordStep(*Simulation);
+            }
+        }
+
+        const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+        const TOptional<ETeam> Winner = BattleResult.IsSet() ? BattleResult->Winner : TOptional<ETeam>();
+        const int32 Steps = Simulation->GetCurrentStep();
+        const FString Result = Winner.IsSet()
+            ? FString::Printf(TEXT("%s wins"), *UEnum::GetValueAsString(Winner.GetValue()))
+            : FString(BattleResult.IsSet() ? TEXT("no survivors") : TEXT("no winner"));
+        const FString SurvivorHP = BattleResult.IsSet()
+            ? FString::Printf(TEXT(" (%d / %d HP)"), BattleResult->SurvivorHP[static_cast<int32>(ETeam::Red)], BattleResult->SurvivorHP[static_cast<int32>(ETeam::Blue)])
+            : FString();
+
+        UE_LOG(LogTemp, Display, TEXT("Run %d (seed %d): %s after %d steps (%.1f simulated s), %d Red / %d Blue left%s, %.2f ms (%.3f ms/step)"),
+            Run,
+            Config.Seed,
+            *Result,
+            Steps,
+            Steps * Config.StepInterval,
+            Simulation->GetAliveCount(ETeam::Red),
+            Simulation->GetAliveCount(ETeam::Blue),
+            *SurvivorHP,
+            ElapsedMs,
+            Steps > 0 ? ElapsedMs / Steps : 0.0);
+
+        if (bRecord)
+        {
+            // One file per run when there are several
+            const FString RunPath = NumRuns > 1
+                ? FPaths::Combine(FPaths::GetPath(RecordPath), FString::Printf(TEXT("%s_%d.%s"), *FPaths::GetBaseFilename(RecordPath), Run, *FPaths::GetExtension(RecordPath)))
+                : RecordPath;
+
+            if (!Replay.SaveToFile(RunPath))
+            {
+                UE_LOG(LogTemp, Error, TEXT("Could not write replay %s"), *RunPath);
+                return 1;
+            }
+        }
+
+        Simulation->CleanUp();
+    }
+
+    return 0;
+}
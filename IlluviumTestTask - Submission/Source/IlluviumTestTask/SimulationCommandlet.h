@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SimulationCommandlet.generated.h"
+
+/*
+====================================================================================
+  USimulationCommandlet - Headless Simulation Runner
+====================================================================================
+
+- Runs complete battles without a world, tiles or agent actors, as fast as the rules
+  allow. Meant for determinism checks, balancing runs and profiling the rules alone.
+
+Usage:
+  UnrealEditor-Cmd <Project>.uproject -run=Simulation [-Seed=123] [-AgentsPerTeam=3]
+      [-GridSize=100] [-GridType=Square|Hex] [-TileSize=100] [-StepInterval=0.1]
+      [-MaxSteps=100000] [-Runs=1] [-Workers=1] [-FlowField] [-SharePaths]
+      [-Pathfinder=AStar|Hierarchical|JumpPoint|Incremental] [-ClusterSize=16]
+      [-AgentClass=/Game/...BP_Ball.BP_Ball_C] [-Record=Battle.simreplay]
+
+- -AgentClass only supplies the rules (move speed, cooldowns); nothing is spawned.
+- -Workers sets the decision workers per step (0 = all task graph workers).
+- -Pathfinder=Hierarchical searches with FHierarchicalPathfinder, in clusters of
+  -ClusterSize cells per side; -Pathfinder=JumpPoint with FJumpPointPathfinder, and
+  -Pathfinder=Incremental with FIncrementalPathfinder.
+- Run N uses Seed + N, and every run logs its winner, step count and timing.
+- -Record writes an FSimulationReplay of each run (Battle_N.simreplay with several runs).
+
+  UnrealEditor-Cmd <Project>.uproject -run=Simulation -Replay=Battle.simreplay [-Workers=1]
+
+- Runs a recorded battle again and fails at the first step whose state hash differs.
+
+  UnrealEditor-Cmd <Project>.uproject -run=Simulation -Benchmark [-Quick] [-Output=Results.json]
+
+- Runs the benchmark suite instead (see SimulationBenchmarks.h) and writes its results
+  as JSON, to Saved/Benchmarks/ unless -Output is given. Add -BenchmarkAllocations to
+  count allocations as well.
+*/
+
+UCLASS()
+class USimulationCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    USimulationCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
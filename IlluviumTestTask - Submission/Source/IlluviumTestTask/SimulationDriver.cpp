@@ -2,8 +2,16 @@
 #include "FHexGrid.h"
 #include "FSquareGrid.h"
 #include "AStarPathfinder.h"
+#include "HierarchicalPathfinder.h"
+#include "JumpPointPathfinder.h"
+#include "IncrementalPathfinder.h"
+#include "SharedPathCache.h"
+#include "AgentPresentationComponent.h"
 #include "Engine/World.h"
 #include "Kismet/GameplayStatics.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
 
 ASimulationDriver::ASimulationDriver()
 {
@@ -20,11 +28,42 @@ void ASimulationDriver::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
 
-    ElapsedTime += DeltaTime;
-    if (ElapsedTime >= StepInterval && Simulation)
+    if (!Simulation || StepInterval <= 0.f)
+        return;
+
+    if (bAsyncPathRequests)
+    {
+        TickAsync(DeltaTime);
+        return;
+    }
+
+    if (Simulation->IsBattleOver())
+        return;
+
+    const double Deadline = FPlatformTime::Seconds() + MaxStepTimeMsPerFrame / 1000.0;
+
+    if (bRunAsFastAsPossible)
     {
-        Simulation->AdvanceStep();
         ElapsedTime = 0.f;
+        do
+        {
+            StepSimulation();
+        } while (!Simulation->IsBattleOver() && FPlatformTime::Seconds() < Deadline);
+        return;
+    }
+
+    ElapsedTime += DeltaTime * SimulationSpeed;
+    while (ElapsedTime >= StepInterval)
+    {
+        StepSimulation();
+        ElapsedTime -= StepInterval;
+
+        if (FPlatformTime::Seconds() >= Deadline)
+        {
+            // Out of budget: keep at most one pending step so a slow frame doesn't snowball into slower ones
+            ElapsedTime = FMath::Min(ElapsedTime, StepInterval);
+            break;
+        }
     }
 }
 
@@ -35,6 +74,27 @@ void ASimulationDriver::EndPlay(const EEndPlayReason::Type EndPlayReason)
         Simulation->CleanUp();
     }
 
+    if (bRecordReplay && Replay.StepHashes.Num() > 0)
+    {
+        const FString ReplayPath = FPaths::ProjectSavedDir() / TEXT("Replays")
+            / FString::Printf(TEXT("Simulation-%d-%s.simreplay"), Seed, *FDateTime::Now().ToString());
+
+        if (Replay.SaveToFile(ReplayPath))
+        {
+            UE_LOG(LogTemp, Log, TEXT("Saved replay of %d steps to %s"), Replay.StepHashes.Num() - 1, *ReplayPath);
+        }
+        else
+        {
+            UE_LOG(LogTemp, Error, TEXT("Could not write replay %s"), *ReplayPath);
+        }
+    }
+
+    if (SharedPathCache)
+    {
+        UE_LOG(LogTemp, Log, TEXT("Shared path cache: %d hits, %d misses, %d invalidated routes"),
+            SharedPathCache->GetHits(), SharedPathCache->GetMisses(), SharedPathCache->GetInvalidations());
+    }
+
     Super::EndPlay(EndPlayReason);
 }
 
@@ -63,28 +123,140 @@ void ASimulationDriver::InitializeSimulation()
 
     GridManager->SetTileActorClass(GridConfig->TileBlueprint);
 
-    // Create geometry from config
+    // Create geometry from config, together with the A* specialised for it
+    TSharedPtr<IPathfinder> GeometryPathfinder;
     switch (GridConfig->GridType)
     {
     case EGridType::Hex:
         Geometry = MakeShared<FHexGrid>(GridConfig->GridSize, GridConfig->TileSize);
+        GeometryPathfinder = MakeShared<TAStarPathfinder<FHexGrid>>();
         break;
     case EGridType::Square:
     default:
         Geometry = MakeShared<FSquareGrid>(GridConfig->GridSize, GridConfig->TileSize);
+        GeometryPathfinder = MakeShared<TAStarPathfinder<FSquareGrid>>();
         break;
     }
 
     GridManager->SetGridGeometry(Geometry);
-    GridManager->SetPathfinder(MakeShared<AStarPathfinder>());
-    GridManager->InitializeGrid(GridConfig->GridSize);
+
+    TSharedPtr<FHierarchicalPathfinder> HierarchicalPathfinder;
+
+    if (bSharePathsBetweenAgents)
+    {
+        SharedPathCache = MakeShared<FSharedPathCache>();
+        Pathfinder = SharedPathCache;
+    }
+    else if (GridConfig->PathfinderType == EPathfinderType::JumpPoint)
+    {
+        if (GridConfig->GridType != EGridType::Square)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Jump Point Search only speeds up square grids; hex paths use plain A*"));
+        }
+        Pathfinder = MakeShared<FJumpPointPathfinder>();
+    }
+    else if (GridConfig->PathfinderType == EPathfinderType::Incremental)
+    {
+        Pathfinder = MakeShared<FIncrementalPathfinder>(GridConfig->IncrementalMaxNodesPerAgent);
+    }
+    else if (GridConfig->PathfinderType == EPathfinderType::Hierarchical)
+    {
+        HierarchicalPathfinder = MakeShared<FHierarchicalPathfinder>(GridConfig->HierarchicalClusterSize);
+        Pathfinder = HierarchicalPathfinder;
+    }
+    else
+    {
+        Pathfinder = GeometryPathfinder;
+    }
+
+    GridManager->SetPathfinder(Pathfinder);
+    GridManager->InitializeGrid(GridConfig->GridSize, GridConfig->StaticObstacles);
+
+    if (HierarchicalPathfinder)
+    {
+        // Build the abstract graph around the static obstacles now rather than inside the first step's searches
+        HierarchicalPathfinder->Build(*Geometry, &GridManager->GetLayers());
+    }
+
+    // One component draws and animates every agent
+    AgentPresentation = NewObject<UAgentPresentationComponent>(this);
+    AgentPresentation->RegisterComponent();
+    AgentPresentation->Initialize(BallAgentClass);
 
     // Create and initialize the simulation system
     Simulation = NewObject<USimulationSystem>(this);
+    Simulation->SetPresenter(AgentPresentation);
+    Simulation->SetUseFlowField(bUseFlowFieldMovement);
+    Simulation->SetDecisionWorkers(DecisionWorkers);
+    // Bound first, since a battle that is over from the start is reported by Initialize()
+    Simulation->OnBattleFinished().AddUObject(this, &ASimulationDriver::HandleBattleFinished);
     Simulation->Initialize(Seed, StepInterval, GridManager, NumAgentsPerTeam, BallAgentClass);
 
+    if (bRecordReplay)
+    {
+        FSimulationRunConfig RunConfig;
+        RunConfig.Seed = Seed;
+        RunConfig.AgentsPerTeam = NumAgentsPerTeam;
+        RunConfig.GridSize = GridConfig->GridSize;
+        RunConfig.TileSize = GridConfig->TileSize;
+        RunConfig.StepInterval = StepInterval;
+        RunConfig.Shape = Geometry->GetShape();
+        RunConfig.bUseFlowField = bUseFlowFieldMovement;
+        RunConfig.bSharePaths = bSharePathsBetweenAgents;
+        RunConfig.PathfinderType = GridConfig->PathfinderType;
+        RunConfig.HierarchicalClusterSize = GridConfig->HierarchicalClusterSize;
+        RunConfig.IncrementalMaxNodesPerAgent = GridConfig->IncrementalMaxNodesPerAgent;
+        RunConfig.StaticObstacles = GridConfig->StaticObstacles;
+        RunConfig.AgentClassPath = BallAgentClass ? BallAgentClass->GetPathName() : FString();
+
+        Replay.Reset(RunConfig);
+        Replay.RecordStep(*Simulation);
+    }
+
     UE_LOG(LogTemp, Log, TEXT("Simulation initialized with GridSize=%d, TileSize=%.1f, Type=%s"),
         GridConfig->GridSize,
         GridConfig->TileSize,
         *UEnum::GetValueAsString(GridConfig->GridType));
 }
+
+void ASimulationDriver::StepSimulation()
+{
+    Simulation->AdvanceStep();
+    OnStepFinished();
+}
+
+void ASimulationDriver::TickAsync(float DeltaTime)
+{
+    // A step begun last frame is finished first; the battle may have ended inside it
+    if (Simulation->IsStepPending())
+    {
+        if (!Simulation->TryFinishStep(LatePathResultBudgetMs / 1000.0))
+            return;
+
+        OnStepFinished();
+    }
+
+    if (Simulation->IsBattleOver())
+        return;
+
+    ElapsedTime += bRunAsFastAsPossible ? StepInterval : DeltaTime * SimulationSpeed;
+    if (ElapsedTime >= StepInterval)
+    {
+        // One step per frame at most, so keep no more than one step's worth of time pending
+        ElapsedTime = FMath::Min(ElapsedTime - StepInterval, StepInterval);
+        Simulation->BeginStep();
+    }
+}
+
+void ASimulationDriver::OnStepFinished()
+{
+    if (bRecordReplay)
+    {
+        Replay.RecordStep(*Simulation);
+    }
+}
+
+void ASimulationDriver::HandleBattleFinished(const FBattleResult& Result)
+{
+    OnBattleFinished.Broadcast(Result.Winner.IsSet(), Result.Winner.Get(ETeam::Red), Result.Steps);
+}
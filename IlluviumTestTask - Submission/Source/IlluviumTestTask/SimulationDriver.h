@@ -4,6 +4,7 @@
 #include "GameFramework/Actor.h"
 #include "MyGridManager.h"
 #include "SimulationSystem.h"
+#include "SimulationReplay.h"
 
 #include "GridGeometryConfig.h"
 #include "SimulationDriver.generated.h"
@@ -14,8 +15,19 @@
 ====================================================================================
 
 - Serves as the main actor that owns and initializes all major simulation systems.
-- Ticks every `IntervalSeconds` (default: 0.1s) to drive simulation forward by
-  calling `AdvanceStep()` on the simulation system.
+- Accumulates frame time (scaled by SimulationSpeed) and calls `AdvanceStep()` once for
+  every `IntervalSeconds` (default: 0.1s) accumulated, so several steps can run in one
+  frame. Stepping stops for the frame once MaxStepTimeMsPerFrame is used up.
+- bRunAsFastAsPossible ignores frame time and steps until the budget is used up.
+- bAsyncPathRequests splits each step over frames: BeginStep() submits the path
+  searches to worker threads and the next frame collects them with TryFinishStep(),
+  waiting at most LatePathResultBudgetMs before leaving them for the frame after.
+  At most one step runs per frame that way, but the game thread only pays for
+  submitting and collecting.
+- bRecordReplay hashes the agent state after every step and saves the battle as an
+  FSimulationReplay to Saved/Replays/ on EndPlay.
+- Broadcasts OnBattleFinished once a team has no agents left, also when that is already
+  the case when the battle is set up.
 
 Holds references to:
  UMyGridManager         ? Manages spatial grid, tile spawning, and agent registration.
@@ -24,6 +36,9 @@ Holds references to:
  IPathfinder            ? Strategy object used for grid-based pathfinding (e.g. A*).
 */
 
+// bHasWinner is false if nobody survived, and Winner is meaningless then
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnSimulationBattleFinished, bool, bHasWinner, ETeam, Winner, int32, Steps);
+
 
 UCLASS()
 class ILLUVIUMTESTTASK_API ASimulationDriver : public AActor
@@ -33,6 +48,12 @@ class ILLUVIUMTESTTASK_API ASimulationDriver : public AActor
 public:
     ASimulationDriver();
 
+    void SetSimulationSpeed(float InSpeed) { SimulationSpeed = FMath::Max(InSpeed, 1.f); }
+    void SetRunAsFastAsPossible(bool bInFastAsPossible) { bRunAsFastAsPossible = bInFastAsPossible; }
+
+    UPROPERTY(BlueprintAssignable, Category = "Simulation")
+    FOnSimulationBattleFinished OnBattleFinished;
+
 protected:
     virtual void BeginPlay() override;
     virtual void Tick(float DeltaTime) override;
@@ -45,6 +66,10 @@ private:
     UPROPERTY()
     UMyGridManager* GridManager;
 
+    UPROPERTY()
+    class UAgentPresentationComponent* AgentPresentation;
+
+    // Simulated time not yet consumed by a step
     float ElapsedTime = 0.f;
     float StepInterval = 0.f;
 
@@ -56,17 +81,68 @@ private:
     UPROPERTY(EditAnywhere, Category = "Simulation")
     float IntervalSeconds = 0.1f;
 
+    //Simulated seconds per real second
+    UPROPERTY(EditAnywhere, Category = "Simulation", meta = (ClampMin = "1.0"))
+    float SimulationSpeed = 1.f;
+
+    //Run as many steps per frame as MaxStepTimeMsPerFrame allows, regardless of frame time
+    UPROPERTY(EditAnywhere, Category = "Simulation")
+    bool bRunAsFastAsPossible = false;
+
+    //Time the simulation may take per frame before the remaining steps are left for the next one
+    UPROPERTY(EditAnywhere, Category = "Simulation", meta = (ClampMin = "0.1"))
+    float MaxStepTimeMsPerFrame = 8.f;
+
     UPROPERTY(EditAnywhere, Category = "Simulation")
     int NumAgentsPerTeam = 3;
 
     UPROPERTY(EditAnywhere, Category = "Simulation")
     TSubclassOf<ABallAgent> BallAgentClass;
 
+    //Move idle agents along a per-team flow field instead of running A* for each of them
+    UPROPERTY(EditAnywhere, Category = "Simulation")
+    bool bUseFlowFieldMovement = false;
+
+    //Id ranges whose decisions are computed in parallel each step; 0 uses every task graph worker, 1 disables it
+    UPROPERTY(EditAnywhere, Category = "Simulation", meta = (ClampMin = "0"))
+    int32 DecisionWorkers = 0;
+
+    //Search a step's paths on worker threads while the game thread moves on, collecting them on the next frame
+    UPROPERTY(EditAnywhere, Category = "Simulation")
+    bool bAsyncPathRequests = false;
+
+    //Time a frame may wait for path results that are still running before leaving them for the next frame
+    UPROPERTY(EditAnywhere, Category = "Simulation", meta = (ClampMin = "0.0", EditCondition = "bAsyncPathRequests"))
+    float LatePathResultBudgetMs = 1.f;
+
+    //Answer path requests towards the same target from a shared FSharedPathCache search tree
+    UPROPERTY(EditAnywhere, Category = "Simulation")
+    bool bSharePathsBetweenAgents = false;
+
+    //Record a per-step state hash, to check the battle later with -run=Simulation -Replay=<File>
+    UPROPERTY(EditAnywhere, Category = "Simulation")
+    bool bRecordReplay = false;
+
     UPROPERTY(EditAnywhere, Category = "Grid")
     UGridGeometryConfig* GridConfig;
 
     TSharedPtr<IGridGeometry> Geometry;
     TSharedPtr<IPathfinder> Pathfinder;
+    TSharedPtr<class FSharedPathCache> SharedPathCache;
+
+    FSimulationReplay Replay;
 
     void InitializeSimulation();
+
+    // Advances the simulation by one step and records it if needed
+    void StepSimulation();
+
+    // Tick with bAsyncPathRequests: finishes the pending step if its paths are in, then begins the next one
+    void TickAsync(float DeltaTime);
+
+    // Records the step that just finished if needed
+    void OnStepFinished();
+
+    // Forwards the simulation's OnBattleFinished() to OnBattleFinished
+    void HandleBattleFinished(const FBattleResult& Result);
 };
@@ -0,0 +1,196 @@
+#include "SimulationReplay.h"
+#include "SimulationSystem.h"
+#include "MyGridManager.h"
+#include "AStarPathfinder.h"
+#include "SharedPathCache.h"
+#include "HierarchicalPathfinder.h"
+#include "JumpPointPathfinder.h"
+#include "IncrementalPathfinder.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+FArchive& operator<<(FArchive& Ar, FSimulationRunConfig& Config)
+{
+    uint8 Shape = static_cast<uint8>(Config.Shape);
+    uint8 PathfinderType = static_cast<uint8>(Config.PathfinderType);
+
+    Ar << Config.Seed;
+    Ar << Config.AgentsPerTeam;
+    Ar << Config.GridSize;
+    Ar << Config.TileSize;
+    Ar << Config.StepInterval;
+    Ar << Shape;
+    Ar << Config.bUseFlowField;
+    Ar << Config.bSharePaths;
+    Ar << PathfinderType;
+    Ar << Config.HierarchicalClusterSize;
+    Ar << Config.IncrementalMaxNodesPerAgent;
+    Ar << Config.StaticObstacles;
+    Ar << Config.AgentClassPath;
+
+    Config.Shape = static_cast<EGridShape>(Shape);
+    Config.PathfinderType = static_cast<EPathfinderType>(PathfinderType);
+    return Ar;
+}
+
+USimulationSystem* FSimulationRunConfig::CreateHeadlessSimulation(int32 DecisionWorkers) const
+{
+    TSubclassOf<ABallAgent> AgentClass;
+    if (!AgentClassPath.IsEmpty())
+    {
+        AgentClass = LoadClass<ABallAgent>(nullptr, *AgentClassPath);
+        if (!AgentClass)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Could not load agent class %s"), *AgentClassPath);
+            return nullptr;
+        }
+    }
+
+    TSharedPtr<IGridGeometry> Geometry;
+    TSharedPtr<IPathfinder> Pathfinder;
+    TSharedPtr<FHierarchicalPathfinder> HierarchicalPathfinder;
+    if (Shape == EGridShape::Hex)
+    {
+        Geometry = MakeShared<FHexGrid>(GridSize, TileSize);
+        Pathfinder = MakeShared<TAStarPathfinder<FHexGrid>>();
+    }
+    else
+    {
+        Geometry = MakeShared<FSquareGrid>(GridSize, TileSize);
+        Pathfinder = MakeShared<TAStarPathfinder<FSquareGrid>>();
+    }
+
+    if (bSharePaths)
+    {
+        Pathfinder = MakeShared<FSharedPathCache>();
+    }
+    else if (PathfinderType == EPathfinderType::JumpPoint)
+    {
+        Pathfinder = MakeShared<FJumpPointPathfinder>();
+    }
+    else if (PathfinderType == EPathfinderType::Incremental)
+    {
+        Pathfinder = MakeShared<FIncrementalPathfinder>(IncrementalMaxNodesPerAgent);
+    }
+    else if (PathfinderType == EPathfinderType::Hierarchical)
+    {
+        HierarchicalPathfinder = MakeShared<FHierarchicalPathfinder>(HierarchicalClusterSize);
+        Pathfinder = HierarchicalPathfinder;
+    }
+
+    UMyGridManager* GridManager = NewObject<UMyGridManager>();
+    GridManager->SetGridGeometry(Geometry);
+    GridManager->SetPathfinder(Pathfinder);
+    GridManager->InitializeGrid(GridSize, StaticObstacles);
+
+    if (HierarchicalPathfinder)
+    {
+        HierarchicalPathfinder->Build(*Geometry, &GridManager->GetLayers());
+    }
+
+    USimulationSystem* Simulation = NewObject<USimulationSystem>();
+    Simulation->SetUseFlowField(bUseFlowField);
+    Simulation->SetDecisionWorkers(DecisionWorkers);
+    Simulation->Initialize(Seed, StepInterval, GridManager, AgentsPerTeam, AgentClass);
+    return Simulation;
+}
+
+void FSimulationReplay::Reset(const FSimulationRunConfig& InConfig)
+{
+    Config = InConfig;
+    StepHashes.Reset();
+}
+
+void FSimulationReplay::RecordStep(const USimulationSystem& Simulation)
+{
+    StepHashes.Add(Simulation.GetAgents().ComputeStateHash());
+}
+
+bool FSimulationReplay::SaveToFile(const FString& Path) const
+{
+    TArray<uint8> Bytes;
+    FMemoryWriter Writer(Bytes);
+
+    uint32 Magic = FileMagic;
+    uint32 Version = FileVersion;
+    Writer << Magic;
+    Writer << Version;
+    Writer << const_cast<FSimulationRunConfig&>(Config);
+    Writer << const_cast<TArray<uint64>&>(StepHashes);
+
+    return FFileHelper::SaveArrayToFile(Bytes, *Path);
+}
+
+bool FSimulationReplay::LoadFromFile(const FString& Path)
+{
+    TArray<uint8> Bytes;
+    if (!FFileHelper::LoadFileToArray(Bytes, *Path))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Could not read replay %s"), *Path);
+        return false;
+    }
+
+    FMemoryReader Reader(Bytes);
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    Reader << Magic;
+    Reader << Version;
+
+    if (Magic != FileMagic || Version != FileVersion)
+    {
+        UE_LOG(LogTemp, Error, TEXT("%s is not a replay of version %u"), *Path, FileVersion);
+        return false;
+    }
+
+    Reader << Config;
+    Reader << StepHashes;
+
+    if (Reader.IsError())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Replay %s is truncated"), *Path);
+        return false;
+    }
+
+    return true;
+}
+
+FReplayVerifyResult FSimulationReplay::Verify(int32 DecisionWorkers) const
+{
+    FReplayVerifyResult Result;
+
+    if (StepHashes.IsEmpty())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Replay has no recorded steps"));
+        return Result;
+    }
+
+    USimulationSystem* Simulation = Config.CreateHeadlessSimulation(DecisionWorkers);
+    if (!Simulation)
+        return Result;
+
+    Result.Status = FReplayVerifyResult::EStatus::Matched;
+
+    for (int32 Step = 0; Step < StepHashes.Num(); ++Step)
+    {
+        if (Step > 0)
+        {
+            Simulation->AdvanceStep();
+        }
+
+        const uint64 Hash = Simulation->GetAgents().ComputeStateHash();
+        if (Hash != StepHashes[Step])
+        {
+            UE_LOG(LogTemp, Error, TEXT("Replay diverged at step %d: recorded %016llx, got %016llx"), Step, StepHashes[Step], Hash);
+            Result.Status = FReplayVerifyResult::EStatus::Diverged;
+            Result.FirstMismatch = Step;
+            break;
+        }
+    }
+
+    Simulation->CleanUp();
+    return Result;
+}
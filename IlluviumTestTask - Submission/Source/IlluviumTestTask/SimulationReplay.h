@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IGridGeometry.h"
+#include "GridGeometryConfig.h"
+
+class USimulationSystem;
+
+/*
+====================================================================================
+  FSimulationReplay - Recorded battle for determinism checks
+====================================================================================
+
+- Stores everything needed to start the same battle again (FSimulationRunConfig) and
+  one 64-bit FSimAgentStore::ComputeStateHash() per step: entry 0 is the state right
+  after spawning, entry N the state after N steps.
+- Verify() runs the battle again from the config and stops at the first step whose
+  hash differs from the recording, which is where the two runs diverged.
+- Saved as a small versioned binary file (8 bytes per step).
+
+Usage:
+  - ASimulationDriver records when bRecordReplay is set and saves on EndPlay.
+  - USimulationCommandlet records with -Record=<File> and checks with -Replay=<File>.
+*/
+
+// Settings a battle's outcome depends on. Decision workers are left out on purpose:
+// every worker count has to give the same result.
+struct FSimulationRunConfig
+{
+    int32 Seed = 123;
+    int32 AgentsPerTeam = 3;
+    int32 GridSize = 100;
+    float TileSize = 100.f;
+    float StepInterval = 0.1f;
+    EGridShape Shape = EGridShape::Square;
+    bool bUseFlowField = false;
+    bool bSharePaths = false;
+
+    // Ignored when bSharePaths is set
+    EPathfinderType PathfinderType = EPathfinderType::AStar;
+    int32 HierarchicalClusterSize = 16;
+    int32 IncrementalMaxNodesPerAgent = 8192;
+
+    // Cells no agent may enter, from UGridGeometryConfig
+    TArray<FIntPoint> StaticObstacles;
+
+    // Agent Blueprint the rules are read from, empty for the ABallAgent defaults
+    FString AgentClassPath;
+
+    // Builds geometry, pathfinder, grid manager and simulation without a world.
+    // Returns null if AgentClassPath cannot be loaded.
+    USimulationSystem* CreateHeadlessSimulation(int32 DecisionWorkers) const;
+
+    friend FArchive& operator<<(FArchive& Ar, FSimulationRunConfig& Config);
+};
+
+// Outcome of FSimulationReplay::Verify()
+struct FReplayVerifyResult
+{
+    enum class EStatus : uint8
+    {
+        Matched,
+        Diverged,
+
+        // Nothing was run: the replay holds no steps or its battle could not be set up
+        SetupFailed
+    };
+
+    EStatus Status = EStatus::SetupFailed;
+
+    // First step whose state differs from the recording, when Diverged
+    int32 FirstMismatch = INDEX_NONE;
+};
+
+struct FSimulationReplay
+{
+    static constexpr uint32 FileMagic = 0x53524550; // "SREP"
+    static constexpr uint32 FileVersion = 5;
+
+    FSimulationRunConfig Config;
+    TArray<uint64> StepHashes;
+
+    // Starts a new recording; call RecordStep() once after spawning and once after every step
+    void Reset(const FSimulationRunConfig& InConfig);
+    void RecordStep(const USimulationSystem& Simulation);
+
+    bool SaveToFile(const FString& Path) const;
+    bool LoadFromFile(const FString& Path);
+
+    // Runs the recorded battle again and reports the first step whose state differs from the
+    // recording, or that every recorded step matches
+    FReplayVerifyResult Verify(int32 DecisionWorkers) const;
+};
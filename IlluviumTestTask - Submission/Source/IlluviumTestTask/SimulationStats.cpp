@@ -0,0 +1,117 @@
+#include "SimulationStats.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "Trace/Trace.h"
+
+DEFINE_STAT(STAT_Simulation_AdvanceStep);
+DEFINE_STAT(STAT_Simulation_UpdateTimers);
+DEFINE_STAT(STAT_Simulation_ApplyCombatEvents);
+DEFINE_STAT(STAT_Simulation_BuildFlowFields);
+DEFINE_STAT(STAT_Simulation_DecideAll);
+DEFINE_STAT(STAT_Simulation_SimulateAttack);
+DEFINE_STAT(STAT_Simulation_SimulateMovement);
+DEFINE_STAT(STAT_Simulation_SubmitPathRequests);
+DEFINE_STAT(STAT_Simulation_CollectPathResults);
+DEFINE_STAT(STAT_Simulation_ResolveDecisions);
+DEFINE_STAT(STAT_Simulation_FindClosestEnemy);
+DEFINE_STAT(STAT_Simulation_FindPath);
+DEFINE_STAT(STAT_Simulation_InitializeGrid);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Path searches / step"), STAT_Simulation_PathSearches, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Nodes expanded / step"), STAT_Simulation_NodesExpanded, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Max nodes expanded / search"), STAT_Simulation_MaxNodesExpanded, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Failed searches / step"), STAT_Simulation_FailedSearches, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Max-step searches / step"), STAT_Simulation_MaxStepSearches, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Spatial queries / step"), STAT_Simulation_SpatialQueries, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Agents moved / step"), STAT_Simulation_AgentsMoved, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Agents blocked / step"), STAT_Simulation_AgentsBlocked, STATGROUP_Simulation);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Step arena bytes / step"), STAT_Simulation_ArenaBytes, STATGROUP_Simulation);
+
+TRACE_DECLARE_INT_COUNTER(SimulationPathSearches, TEXT("Simulation/PathSearches"));
+TRACE_DECLARE_INT_COUNTER(SimulationNodesExpanded, TEXT("Simulation/NodesExpanded"));
+TRACE_DECLARE_INT_COUNTER(SimulationMaxNodesExpanded, TEXT("Simulation/MaxNodesExpanded"));
+TRACE_DECLARE_INT_COUNTER(SimulationFailedSearches, TEXT("Simulation/FailedSearches"));
+TRACE_DECLARE_INT_COUNTER(SimulationMaxStepSearches, TEXT("Simulation/MaxStepSearches"));
+TRACE_DECLARE_INT_COUNTER(SimulationSpatialQueries, TEXT("Simulation/SpatialQueries"));
+TRACE_DECLARE_INT_COUNTER(SimulationAgentsMoved, TEXT("Simulation/AgentsMoved"));
+TRACE_DECLARE_INT_COUNTER(SimulationAgentsBlocked, TEXT("Simulation/AgentsBlocked"));
+TRACE_DECLARE_INT_COUNTER(SimulationArenaBytes, TEXT("Simulation/ArenaBytes"));
+
+UE_TRACE_CHANNEL_DEFINE(SimulationChannel);
+
+std::atomic<bool> SimulationStats::bEnabled = false;
+std::atomic<int64> SimulationStats::Counters[static_cast<int32>(ESimulationCounter::Num)] = {};
+
+namespace
+{
+    FAutoConsoleVariable CVarSimulationStats(
+        TEXT("Simulation.Stats"),
+        false,
+        TEXT("Gathers the simulation's per-step counters and enables the Simulation trace channel."),
+        FConsoleVariableDelegate::CreateLambda([](IConsoleVariable* Variable)
+        {
+            const bool bEnable = Variable->GetBool();
+            SimulationStats::bEnabled.store(bEnable, std::memory_order_relaxed);
+            UE::Trace::ToggleChannel(TEXT("Simulation"), bEnable);
+
+            for (std::atomic<int64>& Counter : SimulationStats::Counters)
+            {
+                Counter.store(0, std::memory_order_relaxed);
+            }
+        }));
+}
+
+void SimulationStats::RecordSearch(int32 NodesExpanded, bool bFoundPath, bool bHitMaxSteps)
+{
+    if (!IsEnabled())
+        return;
+
+    Add(ESimulationCounter::PathSearches);
+    Add(ESimulationCounter::NodesExpanded, NodesExpanded);
+
+    if (!bFoundPath)
+    {
+        Add(bHitMaxSteps ? ESimulationCounter::MaxStepSearches : ESimulationCounter::FailedSearches);
+    }
+
+    std::atomic<int64>& MaxNodes = Counters[static_cast<int32>(ESimulationCounter::MaxNodesExpanded)];
+    int64 Max = MaxNodes.load(std::memory_order_relaxed);
+    while (NodesExpanded > Max && !MaxNodes.compare_exchange_weak(Max, NodesExpanded, std::memory_order_relaxed))
+    {
+    }
+}
+
+void SimulationStats::PublishStep()
+{
+    if (!IsEnabled())
+        return;
+
+    int64 Values[static_cast<int32>(ESimulationCounter::Num)];
+    for (int32 i = 0; i < static_cast<int32>(ESimulationCounter::Num); ++i)
+    {
+        Values[i] = Counters[i].exchange(0, std::memory_order_relaxed);
+    }
+
+    // Counter stats and trace counters both carry int64 values, so the sums are passed on whole
+    auto Get = [&Values](ESimulationCounter Counter) { return Values[static_cast<int32>(Counter)]; };
+
+    SET_DWORD_STAT(STAT_Simulation_PathSearches, Get(ESimulationCounter::PathSearches));
+    SET_DWORD_STAT(STAT_Simulation_NodesExpanded, Get(ESimulationCounter::NodesExpanded));
+    SET_DWORD_STAT(STAT_Simulation_MaxNodesExpanded, Get(ESimulationCounter::MaxNodesExpanded));
+    SET_DWORD_STAT(STAT_Simulation_FailedSearches, Get(ESimulationCounter::FailedSearches));
+    SET_DWORD_STAT(STAT_Simulation_MaxStepSearches, Get(ESimulationCounter::MaxStepSearches));
+    SET_DWORD_STAT(STAT_Simulation_SpatialQueries, Get(ESimulationCounter::SpatialQueries));
+    SET_DWORD_STAT(STAT_Simulation_AgentsMoved, Get(ESimulationCounter::AgentsMoved));
+    SET_DWORD_STAT(STAT_Simulation_AgentsBlocked, Get(ESimulationCounter::AgentsBlocked));
+    SET_DWORD_STAT(STAT_Simulation_ArenaBytes, Get(ESimulationCounter::ArenaBytes));
+
+    TRACE_COUNTER_SET(SimulationPathSearches, Get(ESimulationCounter::PathSearches));
+    TRACE_COUNTER_SET(SimulationNodesExpanded, Get(ESimulationCounter::NodesExpanded));
+    TRACE_COUNTER_SET(SimulationMaxNodesExpanded, Get(ESimulationCounter::MaxNodesExpanded));
+    TRACE_COUNTER_SET(SimulationFailedSearches, Get(ESimulationCounter::FailedSearches));
+    TRACE_COUNTER_SET(SimulationMaxStepSearches, Get(ESimulationCounter::MaxStepSearches));
+    TRACE_COUNTER_SET(SimulationSpatialQueries, Get(ESimulationCounter::SpatialQueries));
+    TRACE_COUNTER_SET(SimulationAgentsMoved, Get(ESimulationCounter::AgentsMoved));
+    TRACE_COUNTER_SET(SimulationAgentsBlocked, Get(ESimulationCounter::AgentsBlocked));
+    TRACE_COUNTER_SET(SimulationArenaBytes, Get(ESimulationCounter::ArenaBytes));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+#include <atomic>
+
+/*
+====================================================================================
+  SimulationStats - Profiling scopes and per-step counters for the simulation
+====================================================================================
+
+- SIMULATION_SCOPE(Name) opens an Unreal Insights CPU scope "Simulation::Name" on the
+  Simulation trace channel and a STAT_Simulation_Name cycle stat (`stat Simulation`).
+- The per-step counters (path searches, nodes expanded, failed and max-step
+  searches, spatial queries, agents moved and blocked, step arena bytes) are summed
+  while a step runs and published by PublishStep() as stats and as Insights counters.
+- Everything is off until `Simulation.Stats 1`, which also enables the trace channel.
+  Works in Test builds through the trace; the cycle and counter stats need STATS.
+
+Notes:
+- Counters are 64-bit atomics, since searches run on the decision workers and path
+  tasks, and thousands of searches of up to MaxExpandedNodes each overflow 32 bits.
+- So is the enabled flag: the console variable sets it on the game thread while
+  workers read it.
+*/
+
+DECLARE_STATS_GROUP(TEXT("Simulation"), STATGROUP_Simulation, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AdvanceStep"), STAT_Simulation_AdvanceStep, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("UpdateTimers"), STAT_Simulation_UpdateTimers, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ApplyCombatEvents"), STAT_Simulation_ApplyCombatEvents, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BuildFlowFields"), STAT_Simulation_BuildFlowFields, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DecideAll"), STAT_Simulation_DecideAll, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SimulateAttack"), STAT_Simulation_SimulateAttack, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SimulateMovement"), STAT_Simulation_SimulateMovement, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SubmitPathRequests"), STAT_Simulation_SubmitPathRequests, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CollectPathResults"), STAT_Simulation_CollectPathResults, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ResolveDecisions"), STAT_Simulation_ResolveDecisions, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FindClosestEnemy"), STAT_Simulation_FindClosestEnemy, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FindPath"), STAT_Simulation_FindPath, STATGROUP_Simulation, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("InitializeGrid"), STAT_Simulation_InitializeGrid, STATGROUP_Simulation, );
+
+UE_TRACE_CHANNEL_EXTERN(SimulationChannel);
+
+#define SIMULATION_SCOPE(Name) \
+    TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("Simulation::" #Name, SimulationChannel); \
+    SCOPE_CYCLE_COUNTER(STAT_Simulation_##Name)
+
+enum class ESimulationCounter : uint8
+{
+    PathSearches,
+    NodesExpanded,
+    MaxNodesExpanded,
+    FailedSearches,
+    MaxStepSearches,
+    SpatialQueries,
+    AgentsMoved,
+    AgentsBlocked,
+    ArenaBytes,
+
+    Num
+};
+
+namespace SimulationStats
+{
+    extern std::atomic<bool> bEnabled;
+    extern std::atomic<int64> Counters[static_cast<int32>(ESimulationCounter::Num)];
+
+    FORCEINLINE bool IsEnabled() { return bEnabled.load(std::memory_order_relaxed); }
+
+    FORCEINLINE void Add(ESimulationCounter Counter, int64 Amount = 1)
+    {
+        if (IsEnabled())
+        {
+            Counters[static_cast<int32>(Counter)].fetch_add(Amount, std::memory_order_relaxed);
+        }
+    }
+
+    // Counts one finished search that closed NodesExpanded cells
+    void RecordSearch(int32 NodesExpanded, bool bFoundPath, bool bHitMaxSteps);
+
+    // Reports the counters gathered since the previous call as this step's values and resets them
+    void PublishStep();
+}
@@ -1,7 +1,26 @@
 ﻿#include "SimulationSystem.h"
+#include "AgentPresentationComponent.h"
+#include "SimulationStats.h"
+#include "StepArena.h"
 #include "Engine/World.h"
 #include "Math/UnrealMathUtility.h"
 #include "Logging/LogMacros.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+    constexpr uint32 SnapshotMagic = 0x534E4150; // "SNAP"
+    constexpr uint32 SnapshotVersion = 1;
+
+    // Magic, version, grid size, step, random stream and agent count
+    constexpr int64 SnapshotHeaderSize = 4 * sizeof(uint32) + sizeof(FRandomStream) + sizeof(int32);
+
+    // The stream is two seeds with no setter for the current one, so it is copied as raw bytes
+    static_assert(sizeof(FRandomStream) == 2 * sizeof(int32) && std::is_trivially_copyable_v<FRandomStream>);
+}
 
 void USimulationSystem::Initialize(
     int32 InSeed,
@@ -21,201 +40,747 @@ void USimulationSystem::Initialize(
     GridSize = GridManager->GetGridSize();
     AgentClass = InAgentClass;
 
-    FActorSpawnParameters Params;
-    Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+    // The rules are tuned on the agent Blueprint, so read them from its class defaults
+    const ABallAgent* AgentDefaults = AgentClass ? AgentClass->GetDefaultObject<ABallAgent>() : GetDefault<ABallAgent>();
+    Rules.MoveSpeed = AgentDefaults->GetMoveSpeed();
+    Rules.AttackCooldown = AgentDefaults->GetAttackCooldown();
+    Rules.PauseBeforeCombatDuration = AgentDefaults->GetPauseBeforeCombatDuration();
+    Rules.AttackDuration = AgentDefaults->GetAttackAnimationDuration();
+    Rules.SetStepInterval(StepInterval);
 
     FVector GridOrigin = GridManager->GetGridOrigin();
-    
-    SpawnAllAgents(NumAgentsPerTeam, Params, GridOrigin);
+
+    for (int32& Count : AliveCounts)
+    {
+        Count = 0;
+    }
+
+    SpawnAllAgents(NumAgentsPerTeam, GridOrigin);
 
     CurrentStep = 0;
+    bBattleFinishedReported = false;
     UE_LOG(LogTemp, Log, TEXT("Simulation initialized with seed %d"), InSeed);
+
+    // No step will run to report it
+    if (IsBattleOver())
+    {
+        ReportBattleFinished();
+    }
 }
 
 void USimulationSystem::AdvanceStep()
 {
-    if (!WorldContext || WorldContext->bIsTearingDown)
+    if (BeginStep())
+    {
+        TryFinishStep();
+    }
+}
+
+bool USimulationSystem::BeginStep()
+{
+    if (bStepPending)
+        return false;
+
+    if (WorldContext && WorldContext->bIsTearingDown)
+        return false;
+
+    // The battle ending was already reported by the step that ended it
+    if (IsBattleOver())
+        return false;
+
+    SIMULATION_SCOPE(AdvanceStep);
+
+    const int32 NumAgents = Agents.Num();
+
+    {
+        SIMULATION_SCOPE(UpdateTimers);
+
+        for (int32 Id = 0; Id < NumAgents; ++Id)
+        {
+            if (Agents.IsAlive(Id))
+            {
+                UpdateAgentTimers(Id);
+            }
+        }
+    }
+
+    {
+        SIMULATION_SCOPE(ApplyCombatEvents);
+        ApplyCombatEvents();
+    }
+
+    bool bTeamHasIdleAgents[NumTeams] = {};
+
+    for (TArray<FIntPoint>& Cells : TeamCells)
+    {
+        Cells.Reset();
+    }
+
+    for (int32 Id = 0; Id < NumAgents; ++Id)
+    {
+        if (Agents.IsAlive(Id))
+        {
+            const int32 TeamIndex = static_cast<int32>(Agents.Team[Id]);
+            bTeamHasIdleAgents[TeamIndex] |= Agents.State[Id] == EAgentState::Idle;
+
+            if (bUseFlowField)
+            {
+                TeamCells[TeamIndex].Add(Agents.Cell[Id]);
+            }
+        }
+    }
+
+    // The decision phase only reads, so anything built lazily has to exist before it starts
+    if (bUseFlowField && GridGeometry)
+    {
+        SIMULATION_SCOPE(BuildFlowFields);
+
+        for (ETeam Team : { ETeam::Red, ETeam::Blue })
+        {
+            if (bTeamHasIdleAgents[static_cast<int32>(Team)])
+            {
+                GetTeamFlowField(Team);
+            }
+        }
+    }
+
+    // Nobody moves before resolution, so the grid's occupancy layer is the step's start for every decision
+    DecideAll();
+    SubmitPathRequests();
+
+    bStepPending = true;
+    return true;
+}
+
+bool USimulationSystem::TryFinishStep(double MaxWaitSeconds)
+{
+    if (!bStepPending)
+        return false;
+
+    {
+        SIMULATION_SCOPE(CollectPathResults);
+
+        const FTimespan Timeout = MaxWaitSeconds < 0.0 ? FTimespan::MaxValue() : FTimespan::FromSeconds(MaxWaitSeconds);
+        if (!PathRequests.Wait(Timeout))
+            return false;
+
+        ApplyPathResults();
+    }
+
+    SIMULATION_SCOPE(AdvanceStep);
+
+    bStepPending = false;
+    const int32 NumAgents = Agents.Num();
+
+    // Resolve in id order, against the state as it changes, so earlier agents win conflicts
+    {
+        SIMULATION_SCOPE(ResolveDecisions);
+
+        for (int32 Id = 0; Id < NumAgents; ++Id)
+        {
+            if (Agents.IsAlive(Id))
+            {
+                ResolveDecision(Id, Decisions[Id]);
+            }
+        }
+    }
+
+    ++CurrentStep;
+
+    SimulationStats::PublishStep();
+
+    if (IsBattleOver() && !bBattleFinishedReported)
+    {
+        ReportBattleFinished();
+    }
+    return true;
+}
+
+void USimulationSystem::SetDecisionWorkers(int32 InNumWorkers)
+{
+    NumDecisionWorkers = InNumWorkers > 0 ? InNumWorkers : FMath::Max(FTaskGraphInterface::Get().GetNumWorkerThreads() + 1, 1);
+}
+
+void USimulationSystem::DecideAll()
+{
+    SIMULATION_SCOPE(DecideAll);
+
+    const int32 NumAgents = Agents.Num();
+    Decisions.SetNum(NumAgents, EAllowShrinking::No);
+
+    auto DecideRange = [this](int32 Begin, int32 End)
+    {
+        // Everything the chunk's agents take from the arena is released at once when it ends
+        FStepArenaScope ArenaScope;
+
+        for (int32 Id = Begin; Id < End; ++Id)
+        {
+            Decisions[Id] = Agents.IsAlive(Id) ? DecideAgent(Id) : FAgentDecision();
+        }
+    };
+
+    // No pathfinder is asked here, see SubmitPathRequests(), so any number of workers is safe
+    const int32 NumChunks = FMath::Min(NumDecisionWorkers, NumAgents);
+
+    if (NumChunks <= 1)
+    {
+        DecideRange(0, NumAgents);
         return;
+    }
 
-    if (AllAgents.FilterByPredicate([](ABallAgent* Agent) {
-        return Agent && Agent->IsAlive() && Agent->GetTeam() == ETeam::Red;
-        }).Num() == 0 ||
-            AllAgents.FilterByPredicate([](ABallAgent* Agent) {
-            return Agent && Agent->IsAlive() && Agent->GetTeam() == ETeam::Blue;
-                }).Num() == 0)
-        return;  //TODO: Send an event to GameMode to determine the winner and end the simulation
+    // Contiguous id ranges, one per worker; each agent only writes its own decision
+    ParallelFor(NumChunks, [NumAgents, NumChunks, &DecideRange](int32 Chunk)
+    {
+        DecideRange(
+            static_cast<int32>(static_cast<int64>(NumAgents) * Chunk / NumChunks),
+            static_cast<int32>(static_cast<int64>(NumAgents) * (Chunk + 1) / NumChunks));
+    });
+}
 
-    AllAgents.RemoveAll([](ABallAgent* Agent) {
-        return !IsValid(Agent) || !Agent->IsAlive();
-        });
+FAgentDecision USimulationSystem::DecideAgent(int32 AgentId) const
+{
+    FAgentDecision Decision;
 
-    TSet<FIntPoint> TempUnwalkable;
+    if (Agents.State[AgentId] != EAgentState::Idle)
+        return Decision;
 
-    for (ABallAgent* Agent : AllAgents)
+    Decision.TargetId = FindAttackTarget(AgentId);
+    if (Decision.TargetId != INDEX_NONE)
     {
-        if (IsValid(Agent) && Agent->IsAlive())
+        Decision.Type = FAgentDecision::EType::Attack;
+    }
+    else if (bUseFlowField)
+    {
+        if (FindFlowFieldStep(AgentId, Decision.NextStep))
         {
-            TempUnwalkable.Add(GridManager->WorldToGrid(Agent->GetCurrentWorldPosition()));
+            Decision.Type = FAgentDecision::EType::Move;
+        }
+    }
+    else if (GridGeometry && Pathfinder)
+    {
+        // The path itself is searched together with every other agent's, see SubmitPathRequests()
+        Decision.TargetId = FindClosestEnemy(AgentId, GridSize);
+        if (Decision.TargetId != INDEX_NONE)
+        {
+            Decision.Type = FAgentDecision::EType::AwaitPath;
         }
     }
 
-    for (ABallAgent* Agent : AllAgents)
+    return Decision;
+}
+
+void USimulationSystem::SubmitPathRequests()
+{
+    SIMULATION_SCOPE(SubmitPathRequests);
+
+    PathRequests.Reset();
+
+    if (!GridGeometry || !Pathfinder)
+        return;
+
+    // In id order, which is the order the results come back in
+    for (int32 Id = 0; Id < Decisions.Num(); ++Id)
+    {
+        const FAgentDecision& Decision = Decisions[Id];
+        if (Decision.Type == FAgentDecision::EType::AwaitPath)
+        {
+            PathRequests.AddRequest(FPathRequest{ Id, Agents.Cell[Id], Agents.Cell[Decision.TargetId], Agents.PreviousCell[Id] });
+        }
+    }
+
+    PathRequests.Submit(*Pathfinder, *GridGeometry, GridManager->GetLayers(), NumDecisionWorkers);
+}
+
+void USimulationSystem::ApplyPathResults()
+{
+    const TConstArrayView<FPathRequest> Requests = PathRequests.GetRequests();
+    const TConstArrayView<TArray<FIntPoint>> Results = PathRequests.GetResults();
+
+    for (int32 Index = 0; Index < Requests.Num(); ++Index)
     {
-        if (!IsValid(Agent) || Agent->IsPendingKillPending() || !Agent->IsAlive())
+        const FPathRequest& Request = Requests[Index];
+        const TArray<FIntPoint>& Path = Results[Index];
+        FAgentDecision& Decision = Decisions[Request.AgentId];
+
+        Decision.TargetId = INDEX_NONE;
+
+        if (Path.Num() <= 1)
+        {
+            UE_LOG(LogTemp, Verbose, TEXT("[Agent %d] No path to enemy at %s"), Request.AgentId, *Request.Goal.ToString());
+            Decision.Type = FAgentDecision::EType::None;
             continue;
+        }
+
+        Decision.Type = FAgentDecision::EType::Move;
+        Decision.NextStep = Path[1];
+    }
+
+    PathRequests.Reset();
+}
 
-        if (!SimulateAttack(Agent))
+void USimulationSystem::ResolveDecision(int32 AgentId, const FAgentDecision& Decision)
+{
+    switch (Decision.Type)
+    {
+    case FAgentDecision::EType::Attack:
+        if (Agents.IsAlive(Decision.TargetId))
         {
-            SimulateMovement(Agent, TempUnwalkable);
+            StartAttack(AgentId, Decision.TargetId);
         }
+        break;
+
+    case FAgentDecision::EType::Move:
+        if (!GridManager->IsOccupied(Decision.NextStep))
+        {
+            MoveAgent(AgentId, Decision.NextStep);
+            SimulationStats::Add(ESimulationCounter::AgentsMoved);
+        }
+        else
+        {
+            // The cell has already been taken in this step by an agent coming to us - wait for it to come and start attacking
+            SimulationStats::Add(ESimulationCounter::AgentsBlocked);
+        }
+        break;
+
+    default:
+        // An idle agent that found neither a target nor a way towards one
+        if (Agents.State[AgentId] == EAgentState::Idle)
+        {
+            SimulationStats::Add(ESimulationCounter::AgentsBlocked);
+        }
+        break;
     }
+}
 
-    ++CurrentStep;
+bool USimulationSystem::IsBattleOver() const
+{
+    return AliveCounts[static_cast<int32>(ETeam::Red)] == 0 || AliveCounts[static_cast<int32>(ETeam::Blue)] == 0;
 }
 
-void USimulationSystem::CleanUp()
+TOptional<ETeam> USimulationSystem::GetWinner() const
+{
+    const int32 RedAlive = GetAliveCount(ETeam::Red);
+    const int32 BlueAlive = GetAliveCount(ETeam::Blue);
+
+    if (RedAlive > 0 && BlueAlive == 0)
+        return ETeam::Red;
+
+    if (BlueAlive > 0 && RedAlive == 0)
+        return ETeam::Blue;
+
+    return {};
+}
+
+void USimulationSystem::RecountAlive()
+{
+    for (int32& Count : AliveCounts)
+    {
+        Count = 0;
+    }
+
+    for (int32 Id = 0; Id < Agents.Num(); ++Id)
+    {
+        if (Agents.IsAlive(Id))
+        {
+            ++AliveCounts[static_cast<int32>(Agents.Team[Id])];
+        }
+    }
+}
+
+FBattleResult USimulationSystem::GetBattleResult() const
 {
-    for (ABallAgent* Agent : AllAgents)
+    FBattleResult Result;
+    Result.Winner = GetWinner();
+    Result.Steps = CurrentStep;
+
+    // Reported once per battle, so the HP can be summed over every agent
+    for (int32 Id = 0; Id < Agents.Num(); ++Id)
     {
-        if (IsValid(Agent))
+        if (Agents.IsAlive(Id))
         {
-            Agent->OnAttackImpact.RemoveDynamic(this, &USimulationSystem::HandleAgentImpact);
-            Agent->OnDeathEvent().RemoveDynamic(this, &USimulationSystem::HandleAgentDeath);
-            Agent->Destroy();
+            const int32 TeamIndex = static_cast<int32>(Agents.Team[Id]);
+            ++Result.Survivors[TeamIndex];
+            Result.SurvivorHP[TeamIndex] += Agents.HP[Id];
         }
     }
-    AllAgents.Empty();
+
+    return Result;
 }
 
-void USimulationSystem::HandleAgentImpact(ABallAgent* Attacker)
+void USimulationSystem::ReportBattleFinished()
+{
+    bBattleFinishedReported = true;
+
+    const FBattleResult Result = GetBattleResult();
+
+    UE_LOG(LogTemp, Log, TEXT("Battle finished after %d steps: %s"), Result.Steps,
+        Result.Winner.IsSet() ? *UEnum::GetValueAsString(Result.Winner.GetValue()) : TEXT("no survivors"));
+
+    BattleFinished.Broadcast(Result);
+}
+
+void USimulationSystem::CleanUp()
 {
-    if (!Attacker || !Attacker->IsAlive()) return;
+    // The searches read the grid and the pathfinder, so they have to finish before anything goes away
+    PathRequests.Reset();
+    bStepPending = false;
+    CombatEvents.Reset();
 
-    ABallAgent* Target = Attacker->GetQueuedCombatTarget();
-    if (!Target || !Target->IsAlive()) return;
+    if (Presenter)
+    {
+        Presenter->ClearAgents();
+    }
+    Agents.Reset();
 
-    Target->ReceiveDamage({
-        .Amount = Attacker->GetPendingDamage(),
-        .Instigator = Attacker
-        });
+    for (int32& Count : AliveCounts)
+    {
+        Count = 0;
+    }
 }
 
-bool USimulationSystem::SimulateAttack(ABallAgent* Agent)
+void USimulationSystem::SaveSnapshot(TArray<uint8>& OutSnapshot) const
 {
-    if (!Agent || !Agent->CanAttack())
+    ensureMsgf(!bStepPending, TEXT("Snapshot taken in the middle of step %d"), CurrentStep);
+
+    OutSnapshot.Reset();
+    FMemoryWriter Writer(OutSnapshot);
+
+    uint32 Magic = SnapshotMagic;
+    uint32 Version = SnapshotVersion;
+    int32 SavedGridSize = GridSize;
+    int32 SavedStep = CurrentStep;
+    FRandomStream SavedStream = RandomStream;
+    int32 NumAgents = Agents.Num();
+
+    Writer << Magic;
+    Writer << Version;
+    Writer << SavedGridSize;
+    Writer << SavedStep;
+    Writer.Serialize(&SavedStream, sizeof(FRandomStream));
+    Writer << NumAgents;
+
+    const_cast<FSimAgentStore&>(Agents).SerializeColumns(Writer, NumAgents);
+}
+
+bool USimulationSystem::RestoreSnapshot(const TArray<uint8>& Snapshot)
+{
+    if (Snapshot.Num() < SnapshotHeaderSize)
+        return false;
+
+    FMemoryReader Reader(Snapshot);
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    int32 SavedGridSize = 0;
+    int32 SavedStep = 0;
+    FRandomStream SavedStream;
+    int32 NumAgents = 0;
+
+    Reader << Magic;
+    Reader << Version;
+    Reader << SavedGridSize;
+    Reader << SavedStep;
+    Reader.Serialize(&SavedStream, sizeof(FRandomStream));
+    Reader << NumAgents;
+
+    if (Magic != SnapshotMagic || Version != SnapshotVersion)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Not a simulation snapshot of version %u"), SnapshotVersion);
         return false;
+    }
+
+    // Ids index the presenter's instances and the partition, so only the same battle fits
+    if (SavedGridSize != GridSize || NumAgents != Agents.Num()
+        || Snapshot.Num() - Reader.Tell() != static_cast<int64>(NumAgents) * FSimAgentStore::SerializedBytesPerAgent)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Snapshot of %d agents on a %d grid does not fit this battle (%d agents on a %d grid)"),
+            NumAgents, SavedGridSize, Agents.Num(), GridSize);
+        return false;
+    }
 
-    const float Range = 100.0f;
-    const ETeam MyTeam = Agent->GetTeam();
-    const FVector MyLocation = Agent->GetCurrentWorldPosition();
-    const FIntPoint MyCell = GridManager->WorldToGrid(MyLocation);
+    // A half-done step belongs to the state being replaced
+    PathRequests.Reset();
+    bStepPending = false;
+    CombatEvents.Reset();
 
-    TArray<ABallAgent*> NearbyAgents = GridManager->GetNeighbouringAgents(MyCell);
-    for (ABallAgent* Other : NearbyAgents)
+    for (int32 Id = 0; Id < Agents.Num(); ++Id)
     {
-        if (!Other || !Other->IsAlive())
-            continue;
+        if (Agents.IsAlive(Id))
+        {
+            GridManager->RemoveAgent(Id, Agents.Cell[Id]);
+        }
+    }
+
+    Agents.SerializeColumns(Reader, NumAgents);
+    CurrentStep = SavedStep;
+    RandomStream = SavedStream;
+
+    // A state the battle was already over in has had its ending reported
+    RecountAlive();
+    bBattleFinishedReported = IsBattleOver();
+
+    // Flow fields are cached per step number, which may now repeat
+    for (int32& Step : TeamFlowFieldSteps)
+    {
+        Step = INDEX_NONE;
+    }
 
-        if (Other->GetTeam() != MyTeam)
+    for (int32 Id = 0; Id < NumAgents; ++Id)
+    {
+        if (Agents.IsAlive(Id))
         {
-            return Agent->TryAttack(Other, DamagePerAttack, Other->GetCurrentWorldPosition());
+            GridManager->RegisterAgent(Id, Agents.Team[Id], Agents.Cell[Id]);
+        }
+
+        if (Presenter)
+        {
+            Presenter->SnapAgent(Id, GridManager->GridToWorld(Agents.Cell[Id]), Agents.HP[Id], Agents.MaxHP[Id]);
         }
     }
 
-    return false;
+    return true;
 }
 
-void USimulationSystem::SimulateMovement(ABallAgent* Agent, const TSet<FIntPoint>& TempUnwalkable)
+void USimulationSystem::UpdateAgentTimers(int32 AgentId)
 {
-    if (!GridGeometry || !Pathfinder || Agent->GetState() != EAgentState::Idle)
+    ++Agents.StepsSinceLastAttack[AgentId];
+    ++Agents.StateSteps[AgentId];
+
+    if (Agents.StateSteps[AgentId] < Agents.StateDurationSteps[AgentId])
         return;
 
-    ABallAgent* ClosestEnemy = FindClosestEnemy(Agent, GridSize);
-    if (!ClosestEnemy) return;
+    switch (Agents.State[AgentId])
+    {
+    case EAgentState::Moving:
+        Agents.State[AgentId] = EAgentState::Idle;
+        break;
+
+    case EAgentState::WaitingForCombat:
+        Agents.State[AgentId] = EAgentState::InCombat;
+        Agents.StateSteps[AgentId] = 0;
+        Agents.StateDurationSteps[AgentId] = Rules.AttackSteps;
+
+        if (Presenter)
+        {
+            Presenter->StrikeAttack(AgentId);
+        }
+        break;
 
-    FIntPoint AgentGridPos = GridManager->WorldToGrid(Agent->GetCurrentWorldPosition());
+    case EAgentState::InCombat:
+        QueueImpact(AgentId);
+        break;
 
-    TSet<FIntPoint> LocalUnwalkable = TempUnwalkable;
-    FIntPoint TargetGridPos = GridManager->WorldToGrid(ClosestEnemy->GetCurrentWorldPosition());
-    LocalUnwalkable.Remove(AgentGridPos);
-    LocalUnwalkable.Remove(TargetGridPos);
+    default:
+        break;
+    }
+}
 
-    FIntPoint PreviousCell = GridManager->GetPreviousCellForAgent(Agent);
+void USimulationSystem::QueueImpact(int32 AttackerId)
+{
+    CombatEvents.Add(FCombatEvent{ FCombatEvent::EType::Impact, AttackerId, Agents.TargetId[AttackerId], Agents.PendingDamage[AttackerId] });
 
-    TArray<FIntPoint> Path = Pathfinder->FindPath(
-        AgentGridPos,
-        TargetGridPos,
-        *GridGeometry,
-        &PreviousCell,
-        &LocalUnwalkable
-    );
+    Agents.TargetId[AttackerId] = INDEX_NONE;
+    Agents.State[AttackerId] = EAgentState::Idle;
+}
 
-    if (Path.Num() <= 1)
+void USimulationSystem::ApplyCombatEvents()
+{
+    // The timers ran in id order, so the impacts are in attacker id order and land as if each hit when its timer ran
+    const int32 NumImpacts = CombatEvents.Num();
+    for (int32 Index = 0; Index < NumImpacts; ++Index)
     {
-        UE_LOG(LogTemp, Verbose, TEXT("[%s] No path to enemy at %s"), *Agent->GetName(), *TargetGridPos.ToString());
-        return;
+        const FCombatEvent& Impact = CombatEvents[Index];
+        if (ApplyImpact(Impact))
+        {
+            CombatEvents.Add(FCombatEvent{ FCombatEvent::EType::Death, Impact.TargetId });
+        }
     }
-    else
+
+    if (CombatEvents.Num() > NumImpacts)
     {
-        const FIntPoint& NextStep = Path[1];
+        for (int32 Index = NumImpacts; Index < CombatEvents.Num(); ++Index)
+        {
+            KillAgent(CombatEvents[Index].AgentId);
+        }
+
+        CancelAttacksOnDeadTargets();
+    }
+
+    CombatEvents.Reset();
+}
+
+bool USimulationSystem::ApplyImpact(const FCombatEvent& Impact)
+{
+    const int32 AttackerId = Impact.AgentId;
+    const int32 TargetId = Impact.TargetId;
 
-        if (GridManager->IsOccupied(NextStep))
+    // Killed by an earlier impact of this step, so it never got to strike
+    if (!Agents.IsAlive(AttackerId))
+        return false;
+
+    if (!Agents.IsValidId(TargetId) || !Agents.IsAlive(TargetId))
+    {
+        // The target died earlier in this step, which cancels the attack
+        if (Presenter && Agents.IsValidId(TargetId))
         {
-            // The cell has already been reserved in this step by an enemy coming to us - wait for it to come and start attacking  
-            return;
+            Presenter->CancelAttack(AttackerId);
         }
+        return false;
+    }
 
-        FVector TargetPos = GridManager->GridToWorld(NextStep);
-        GridManager->UpdateAgentPosition(Agent, NextStep);
-        Agent->MoveToWorldLocation(TargetPos);
-        Agent->SetCurrentLogicalWorldPosition(TargetPos);
+    Agents.HP[TargetId] = FMath::Max(Agents.HP[TargetId] - Impact.Damage, 0);
+    UE_LOG(LogTemp, Log, TEXT("Agent %d received %d damage from agent %d"), TargetId, Impact.Damage, AttackerId);
+
+    if (Presenter)
+    {
+        Presenter->ShowDamage(TargetId, Agents.HP[TargetId], Agents.MaxHP[TargetId]);
     }
+
+    return !Agents.IsAlive(TargetId);
 }
 
-ABallAgent* USimulationSystem::FindClosestEnemy(ABallAgent* Seeker, int32 MaxSearchRadius) const
+void USimulationSystem::KillAgent(int32 AgentId)
 {
-    if (!Seeker || !GridManager) return nullptr;
+    Agents.State[AgentId] = EAgentState::Dead;
+    Agents.TargetId[AgentId] = INDEX_NONE;
+    --AliveCounts[static_cast<int32>(Agents.Team[AgentId])];
+    GridManager->RemoveAgent(AgentId, Agents.Cell[AgentId]);
 
-    const ETeam MyTeam = Seeker->GetTeam();
-    const FVector MyLocation = Seeker->GetCurrentWorldPosition();
-    const FIntPoint MyCell = GridManager->WorldToGrid(MyLocation);
+    if (Pathfinder)
+    {
+        Pathfinder->ForgetAgent(AgentId);
+    }
 
-    ABallAgent* ClosestEnemy = nullptr;
-    float ClosestDistSq = TNumericLimits<float>::Max();
+    if (Presenter)
+    {
+        Presenter->RemoveAgent(AgentId);
+    }
+}
 
-    for (int32 Radius = 1; Radius <= MaxSearchRadius; ++Radius)
+void USimulationSystem::CancelAttacksOnDeadTargets()
+{
+    // One sweep for all of the step's deaths: attackers still aiming at a dead agent go back to idle
+    for (int32 Id = 0; Id < Agents.Num(); ++Id)
     {
-        TArray<ABallAgent*> Nearby = GridManager->GetSurroundingAgents(MyCell, Radius);
-        for (ABallAgent* Other : Nearby)
+        const int32 TargetId = Agents.TargetId[Id];
+        if (TargetId == INDEX_NONE || Agents.IsAlive(TargetId))
+            continue;
+
+        Agents.TargetId[Id] = INDEX_NONE;
+        Agents.State[Id] = EAgentState::Idle;
+
+        if (Presenter)
         {
-            if (!Other || !Other->IsAlive() || Other->GetTeam() == MyTeam)
-                continue;
+            Presenter->CancelAttack(Id);
+        }
+    }
+}
 
-            float DistSq = FVector::DistSquared(MyLocation, Other->GetCurrentWorldPosition());
-            if (DistSq < ClosestDistSq)
-            {
-                ClosestDistSq = DistSq;
-                ClosestEnemy = Other;
-            }
+int32 USimulationSystem::FindAttackTarget(int32 AgentId) const
+{
+    SIMULATION_SCOPE(SimulateAttack);
+
+    if (Agents.StepsSinceLastAttack[AgentId] < Rules.AttackCooldownSteps)
+        return INDEX_NONE;
+
+    const ETeam MyTeam = Agents.Team[AgentId];
+
+    // Runs inside DecideAll()'s arena scope
+    TStepArray<int32> NearbyAgents;
+    GridManager->GetNeighbouringAgents(Agents.Cell[AgentId], NearbyAgents);
+
+    for (int32 OtherId : NearbyAgents)
+    {
+        if (Agents.IsAlive(OtherId) && Agents.Team[OtherId] != MyTeam)
+        {
+            return OtherId;
         }
+    }
+
+    return INDEX_NONE;
+}
 
-        if (ClosestEnemy)
-            break; // Stop as soon as a valid enemy is found in this ring
+void USimulationSystem::StartAttack(int32 AgentId, int32 TargetId)
+{
+    Agents.TargetId[AgentId] = TargetId;
+    Agents.PendingDamage[AgentId] = Rules.DamagePerAttack;
+    Agents.State[AgentId] = EAgentState::WaitingForCombat;
+    Agents.StateSteps[AgentId] = 0;
+    Agents.StateDurationSteps[AgentId] = Rules.PauseBeforeCombatSteps;
+
+    if (Presenter)
+    {
+        Presenter->BeginAttack(AgentId, GridManager->GridToWorld(Agents.Cell[TargetId]));
     }
+}
 
-    return ClosestEnemy;
+bool USimulationSystem::FindFlowFieldStep(int32 AgentId, FIntPoint& OutNextStep) const
+{
+    SIMULATION_SCOPE(SimulateMovement);
+
+    if (!GridGeometry || !Pathfinder)
+        return false;
+
+    const FIntPoint AgentGridPos = Agents.Cell[AgentId];
+    const FIntPoint PreviousCell = Agents.PreviousCell[AgentId];
+
+    const FTeamFlowField& FlowField = TeamFlowFields[static_cast<int32>(Agents.Team[AgentId])];
+    if (!FlowField.GetNextStep(AgentGridPos, *GridGeometry, &PreviousCell, OutNextStep))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("[Agent %d] No reachable enemy from %s"), AgentId, *AgentGridPos.ToString());
+        return false;
+    }
+    return true;
 }
 
+void USimulationSystem::MoveAgent(int32 AgentId, const FIntPoint& NextStep)
+{
+    const FIntPoint AgentGridPos = Agents.Cell[AgentId];
+    const FVector StartPos = GridManager->GridToWorld(AgentGridPos);
+    const FVector TargetPos = GridManager->GridToWorld(NextStep);
+    GridManager->UpdateAgentPosition(AgentId, AgentGridPos, NextStep);
+
+    Agents.PreviousCell[AgentId] = AgentGridPos;
+    Agents.Cell[AgentId] = NextStep;
+    Agents.State[AgentId] = EAgentState::Moving;
+    Agents.StateSteps[AgentId] = 0;
+    Agents.StateDurationSteps[AgentId] = Rules.MoveSpeed > 0.f
+        ? FSimulationRules::ToSteps(FVector::Dist(StartPos, TargetPos) / Rules.MoveSpeed, StepInterval)
+        : 0;
+
+    if (Presenter)
+    {
+        Presenter->MoveAgent(AgentId, TargetPos);
+    }
+}
 
-void USimulationSystem::HandleAgentDeath(ABallAgent* Agent)
+const FTeamFlowField& USimulationSystem::GetTeamFlowField(ETeam Team)
 {
-    GridManager->RemoveAgent(Agent);
+    const int32 TeamIndex = static_cast<int32>(Team);
+    FTeamFlowField& FlowField = TeamFlowFields[TeamIndex];
+
+    if (TeamFlowFieldSteps[TeamIndex] != CurrentStep)
+    {
+        // Seeded from the enemy positions captured at the start of the step, before anyone moved, and
+        // covering the area around both armies
+        FlowField.Build(*GridGeometry, TeamCells[1 - TeamIndex], TeamCells[TeamIndex], FPathBlockers(GridManager->GetLayers()));
+        TeamFlowFieldSteps[TeamIndex] = CurrentStep;
+    }
+
+    return FlowField;
 }
 
-void USimulationSystem::SpawnAllAgents(int32 NumAgentsPerTeam, const FActorSpawnParameters& Params, FVector GridOrigin)
+int32 USimulationSystem::FindClosestEnemy(int32 SeekerId, int32 MaxSearchRadius) const
 {
-    TSet<FIntPoint> OccupiedCells;
+    SIMULATION_SCOPE(FindClosestEnemy);
 
+    if (!GridManager) return INDEX_NONE;
+
+    return GridManager->FindNearestEnemy(Agents.Cell[SeekerId], Agents.Team[SeekerId], MaxSearchRadius);
+}
+
+void USimulationSystem::SpawnAllAgents(int32 NumAgentsPerTeam, FVector GridOrigin)
+{
     for (ETeam Team : { ETeam::Red, ETeam::Blue })
     {
         int32 Spawned = 0;
@@ -229,7 +794,7 @@ void USimulationSystem::SpawnAllAgents(int32 NumAgentsPerTeam, const FActorSpawn
             for (int32 Attempts = 0; Attempts < MaxAttempts; ++Attempts)
             {
                 Start = FIntPoint(RandomStream.RandRange(0, GridSize - 1), RandomStream.RandRange(0, GridSize - 1));
-                if (!OccupiedCells.Contains(Start))
+                if (GridManager->IsWalkable(Start) && !GridManager->IsOccupied(Start))
                 {
                     bFound = true;
                     break;
@@ -242,31 +807,26 @@ void USimulationSystem::SpawnAllAgents(int32 NumAgentsPerTeam, const FActorSpawn
                 break;
             }
 
-            OccupiedCells.Add(Start);
             FVector Location = GridGeometry->GetTileWorldPosition(Start, GridOrigin);
 
-            ABallAgent* Agent = SpawnAgent(Team, Location, Start, Params);
-            if (Agent)
-            {
-                AllAgents.Add(Agent);
-                Agent->OnAttackImpact.AddDynamic(this, &USimulationSystem::HandleAgentImpact);
-                Agent->OnDeathEvent().AddDynamic(this, &USimulationSystem::HandleAgentDeath);
-                ++Spawned;
-            }
+            SpawnAgent(Team, Location, Start);
+            ++Spawned;
         }
     }
 }
 
-ABallAgent* USimulationSystem::SpawnAgent(ETeam Team, const FVector& Location, const FIntPoint& GridCell, const FActorSpawnParameters& Params)
+int32 USimulationSystem::SpawnAgent(ETeam Team, const FVector& Location, const FIntPoint& GridCell)
 {
-    ABallAgent* Agent = WorldContext->SpawnActor<ABallAgent>(AgentClass, Location, FRotator::ZeroRotator, Params);
-    if (!Agent) return nullptr;
+    const int32 HP = RandomStream.RandRange(Rules.MinSpawnHP, Rules.MaxSpawnHP);
+    const int32 AgentId = Agents.Add(Team, HP, GridCell);
+    ++AliveCounts[static_cast<int32>(Team)];
 
-    const int32 HP = RandomStream.RandRange(2, 5);
-    Agent->Initialize(Location, HP);
-    Agent->SetTeam(Team);
-    GridManager->RegisterAgent(Agent);
+    GridManager->RegisterAgent(AgentId, Team, GridCell);
 
-    return Agent;
-}
+    if (Presenter)
+    {
+        Presenter->AddAgent(AgentId, Team, Location);
+    }
 
+    return AgentId;
+}
@@ -2,8 +2,11 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "SimulationTypes.h"
 #include "BallAgent.h"
 #include "MyGridManager.h"
+#include "TeamFlowField.h"
+#include "PathRequestBatch.h"
 #include "SimulationSystem.generated.h"
 
 /*
@@ -11,31 +14,106 @@
   USimulationSystem - Core Simulation Logic Manager
 ====================================================================================
 
-- Owns the simulation logic and agent state.
+- Owns the simulation logic and agent state (FSimAgentStore, one column per agent field).
 - Called by the SimulationDriver every IntervalSeconds to advance the simulation.
+- Runs without any visuals as well (see USimulationCommandlet). With a presenter set,
+  every visible change is reported to it by agent id.
 
 Responsibilities:
- AdvanceStep()
-    - Checks if both teams are still alive.
-    - Triggers attacks if enemies are in range.
-    - Moves agents toward closest enemy if no attack is performed.
+ AdvanceStep() = BeginStep() + TryFinishStep()
+    - Checks if both teams are still alive, from per-team counts kept as agents spawn and die.
+    - Advances movement, combat pause and attack timers by the step interval; the hits
+      they land are queued as FCombatEvents and applied in one pass afterwards.
+    - Decides for every idle agent, against the state at the start of the step, whether it
+      attacks an enemy in range or which enemy it moves towards (DecideAll, parallel).
+    - Submits the path searches towards those enemies as one FPathRequestBatch, which
+      runs on worker threads; BeginStep() returns here.
+    - Collects the paths in request order and resolves the decisions in agent id order:
+      a move into a cell taken earlier in the step is dropped (ResolveDecision, sequential).
+    - Broadcasts OnBattleFinished() at the end of the step that left a team without agents,
+      or from Initialize() if a team spawned without any.
 
  SpawnAgent / SpawnAllAgents()
     - Spawns agents at random walkable grid positions.
-    - Registers them with the grid manager and binds to death/impact delegates.
+    - Registers them with the grid manager and the presenter.
 
- HandleAgentImpact / HandleAgentDeath
-    - Applies damage and removes agents from spatial partition on death.
+ ApplyCombatEvents()
+    - Applies the step's hits in attacker id order, removes the agents they kill from the
+      spatial partition, and cancels the attacks on those agents in one sweep.
+
+ SaveSnapshot / RestoreSnapshot()
+    - Copies the whole battle state to and from a compact binary blob, for rewinding
+      and branching from the middle of a battle.
 
 Notes:
 - Agent actions are deterministic based on RandomStream seed.
+- All timers are counted in steps (see FSimulationRules), never in frame time, so
+  any number of steps can run per frame without changing the outcome.
+- The decision phase only reads shared state, so it gives the same decisions on any
+  number of workers (SetDecisionWorkers); the path batch runs as one task when the
+  pathfinder does not support concurrent queries.
+- Between BeginStep() and TryFinishStep() the state is frozen, so when the results are
+  collected (in the same call or frames later) does not change the outcome.
+- With SetUseFlowField(true) idle agents follow a per-team FTeamFlowField built once
+  per step, over the area around both armies, instead of running FindClosestEnemy
+  and FindPath each.
 */
 
 
 class FMyGridManager;
+class UAgentPresentationComponent;
 class IGridGeometry;
 class IPathfinder;
 
+// What an agent chose to do this step, taken from the state at the start of the step
+struct FAgentDecision
+{
+    enum class EType : uint8
+    {
+        None,
+        Attack,
+        Move,
+
+        // Moves towards TargetId along a path searched with the step's FPathRequestBatch
+        AwaitPath
+    };
+
+    EType Type = EType::None;
+    int32 TargetId = INDEX_NONE;
+    FIntPoint NextStep = FIntPoint::ZeroValue;
+};
+
+// A hit landed or a death caused in the current step, queued while the timers run
+struct FCombatEvent
+{
+    enum class EType : uint8
+    {
+        Impact,
+        Death
+    };
+
+    EType Type = EType::Impact;
+
+    // The attacker for an Impact, the agent that died for a Death
+    int32 AgentId = INDEX_NONE;
+    int32 TargetId = INDEX_NONE;
+    int32 Damage = 0;
+};
+
+// How a battle ended, as broadcast by USimulationSystem::OnBattleFinished()
+struct FBattleResult
+{
+    // Unset if nobody survived
+    TOptional<ETeam> Winner;
+    int32 Steps = 0;
+
+    // Agents left per team and the HP they have left between them, indexed by ETeam
+    int32 Survivors[NumTeams] = {};
+    int32 SurvivorHP[NumTeams] = {};
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBattleFinished, const FBattleResult&);
+
 UCLASS()
 class USimulationSystem : public UObject
 {
@@ -51,26 +129,117 @@ public:
 
     void CleanUp();
 
+    // Runs a whole step: BeginStep() and a TryFinishStep() that waits as long as it takes
     void AdvanceStep();
 
+    // First half of a step: timers, decisions and submitting the path searches, which run on
+    // worker threads. Returns false if no step was begun (battle over, world tearing down or a
+    // step still pending).
+    bool BeginStep();
+
+    // Second half of a step: collects the paths and resolves the decisions. Waits at most
+    // MaxWaitSeconds for searches still running (negative waits as long as it takes) and returns
+    // false, the step staying pending, if they did not finish in time.
+    bool TryFinishStep(double MaxWaitSeconds = -1.0);
+
+    // Between BeginStep() and a successful TryFinishStep(). Nothing may change the battle meanwhile;
+    // RestoreSnapshot() and CleanUp() drop the pending step.
+    bool IsStepPending() const { return bStepPending; }
+
+    void SetUseFlowField(bool bInUseFlowField) { bUseFlowField = bInUseFlowField; }
+
+    // Visuals to keep in sync with the agents; set before Initialize(), may be null
+    void SetPresenter(UAgentPresentationComponent* InPresenter) { Presenter = InPresenter; }
+
+    // Number of id ranges decided in parallel each step; 1 decides on the calling thread, 0 uses every worker
+    void SetDecisionWorkers(int32 InNumWorkers);
+
+    // O(1), from the alive counts
+    bool IsBattleOver() const;
+
+    // Team with agents left once the battle is over; unset while it is running or if nobody survived
+    TOptional<ETeam> GetWinner() const;
+
+    // Kept up to date as agents spawn and die
+    int32 GetAliveCount(ETeam Team) const { return AliveCounts[static_cast<int32>(Team)]; }
+
+    // Broadcast once per battle, at the end of the step in which a team lost its last agent. Restoring
+    // a snapshot from before that step lets it be broadcast again. A battle that is over as soon as it
+    // is spawned is broadcast from Initialize(), so bind before calling it to hear about that one.
+    FOnBattleFinished& OnBattleFinished() { return BattleFinished; }
+
+    // Winner, step and survivors as they are now; what OnBattleFinished() broadcasts once the battle is over
+    FBattleResult GetBattleResult() const;
+
+    int32 GetCurrentStep() const { return CurrentStep; }
+
+    // Read-only view of the agent state for presentation and tools
+    const FSimAgentStore& GetAgents() const { return Agents; }
+
+    // Writes the battle state at the current step (agents, step counter, random stream) into
+    // OutSnapshot as a versioned binary blob, reusing its allocation
+    void SaveSnapshot(TArray<uint8>& OutSnapshot) const;
+
+    // Returns to a state saved by SaveSnapshot() of this battle (same grid size and agent count),
+    // re-registering occupancy with the grid manager and snapping the presenter's agents.
+    // Nothing is reallocated or respawned. Returns false and leaves the state untouched if the
+    // snapshot does not fit.
+    bool RestoreSnapshot(const TArray<uint8>& Snapshot);
+
 private:
-    void SimulateMovement(ABallAgent* Agent, const TSet<FIntPoint>& TempUnwalkale);
-    bool SimulateAttack(ABallAgent* Agent);
+    void UpdateAgentTimers(int32 AgentId);
+
+    // Decision phase - reads shared state only and writes Decisions[AgentId]
+    void DecideAll();
+    FAgentDecision DecideAgent(int32 AgentId) const;
+    int32 FindAttackTarget(int32 AgentId) const;
+    bool FindFlowFieldStep(int32 AgentId, FIntPoint& OutNextStep) const;
 
-    void SpawnAllAgents(int32 NumAgentsPerTeam, const FActorSpawnParameters& Params, FVector GridOrigin);
-    ABallAgent* SpawnAgent(ETeam Team, const FVector& Location, const FIntPoint& GridCell, const FActorSpawnParameters& Params);
+    // Path searches for the AwaitPath decisions, and turning their results into moves
+    void SubmitPathRequests();
+    void ApplyPathResults();
 
-    ABallAgent* FindClosestEnemy(ABallAgent* Seeker, int32 MaxSearchRadius) const;
+    // Resolution phase
+    void ResolveDecision(int32 AgentId, const FAgentDecision& Decision);
+    void StartAttack(int32 AgentId, int32 TargetId);
+    void MoveAgent(int32 AgentId, const FIntPoint& NextStep);
 
-    UFUNCTION()
-    void HandleAgentImpact(ABallAgent* Attacker);
+    // Combat - impacts are queued by UpdateAgentTimers() and applied after every timer has run
+    void QueueImpact(int32 AttackerId);
+    void ApplyCombatEvents();
+    bool ApplyImpact(const FCombatEvent& Impact);
+    void KillAgent(int32 AgentId);
+    void CancelAttacksOnDeadTargets();
 
-    UFUNCTION()
-    void HandleAgentDeath(ABallAgent* Agent);
+    // Counts the living agents of each team from scratch, for states that did not come from spawning
+    void RecountAlive();
+    void ReportBattleFinished();
+
+    void SpawnAllAgents(int32 NumAgentsPerTeam, FVector GridOrigin);
+    int32 SpawnAgent(ETeam Team, const FVector& Location, const FIntPoint& GridCell);
+
+    int32 FindClosestEnemy(int32 SeekerId, int32 MaxSearchRadius) const;
+
+    // Field leading agents of Team towards their enemies, built on first use in the current step
+    const FTeamFlowField& GetTeamFlowField(ETeam Team);
 
 private:
+    FSimAgentStore Agents;
+    TArray<FAgentDecision> Decisions;
+    int32 NumDecisionWorkers = 1;
+
+    // Impacts in queue order, followed by the deaths they caused; empty between steps
+    TArray<FCombatEvent> CombatEvents;
+
+    int32 AliveCounts[NumTeams] = {};
+    bool bBattleFinishedReported = false;
+    FOnBattleFinished BattleFinished;
+
+    FPathRequestBatch PathRequests;
+    bool bStepPending = false;
+
     UPROPERTY()
-    TArray<ABallAgent*> AllAgents;
+    TObjectPtr<UAgentPresentationComponent> Presenter;
 
     UPROPERTY()
     TObjectPtr<UMyGridManager> GridManager;
@@ -84,7 +253,15 @@ private:
     int32 CurrentStep = 0;
 
     float StepInterval = 0.1f;
-    float DamagePerAttack = 1.f;
+
+    FSimulationRules Rules;
 
     FRandomStream RandomStream;
+
+    bool bUseFlowField = false;
+    FTeamFlowField TeamFlowFields[NumTeams];
+    int32 TeamFlowFieldSteps[NumTeams] = { INDEX_NONE, INDEX_NONE };
+
+    // Cells of each team's living agents at the start of the step, used to seed the flow fields
+    TArray<FIntPoint> TeamCells[NumTeams];
 };
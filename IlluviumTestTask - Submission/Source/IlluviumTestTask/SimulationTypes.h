@@ -0,0 +1,177 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Hash/xxhash.h"
+#include "SimulationTypes.generated.h"
+
+/*
+====================================================================================
+  Simulation Types - Plain data shared by the simulation and its visualisers
+====================================================================================
+
+- FSimAgentStore is everything the rules know about the agents, kept as one array per
+  field so passes over a single field (team, HP, state...) read contiguous memory.
+  Agents are addressed by their id, the index into every column, which never changes
+  during a run. ComputeStateHash() condenses the fields that decide a battle into 64
+  bits, so two runs can be compared step by step (see FSimulationReplay), and
+  SerializeColumns() copies every column as raw bytes for snapshots.
+- FSimulationRules holds the tunables the rules run with. Durations are authored in
+  seconds and counted in whole steps, so results never depend on frame timing. USimulationSystem fills it
+  from the ABallAgent class defaults, so Blueprint values apply to headless runs too.
+*/
+
+UENUM(BlueprintType)
+enum class ETeam : uint8
+{
+    Red,
+    Blue
+};
+
+// Number of ETeam entries, used to size per-team arrays
+constexpr int32 NumTeams = 2;
+
+UENUM(BlueprintType)
+enum class EAgentState : uint8
+{
+    Idle,
+    Moving,
+    WaitingForCombat,
+    InCombat,
+    Dead
+};
+
+struct FSimAgentStore
+{
+    // Appends an idle agent standing on Cell and returns its id
+    int32 Add(ETeam InTeam, int32 InHP, const FIntPoint& InCell)
+    {
+        const int32 Id = Team.Add(InTeam);
+        State.Add(EAgentState::Idle);
+        MaxHP.Add(InHP);
+        HP.Add(InHP);
+        Cell.Add(InCell);
+        PreviousCell.Add(InCell);
+        StepsSinceLastAttack.Add(0);
+        StateSteps.Add(0);
+        StateDurationSteps.Add(0);
+        TargetId.Add(INDEX_NONE);
+        PendingDamage.Add(0);
+        return Id;
+    }
+
+    void Reset()
+    {
+        Team.Reset();
+        State.Reset();
+        MaxHP.Reset();
+        HP.Reset();
+        Cell.Reset();
+        PreviousCell.Reset();
+        StepsSinceLastAttack.Reset();
+        StateSteps.Reset();
+        StateDurationSteps.Reset();
+        TargetId.Reset();
+        PendingDamage.Reset();
+    }
+
+    // Hash of every agent's cell, HP, state and target. Each column is hashed as one
+    // buffer with XXH3, which runs at memory bandwidth, so this can stay on every step.
+    uint64 ComputeStateHash() const
+    {
+        FXxHash64Builder Builder;
+        Builder.Update(Cell.GetData(), Cell.Num() * sizeof(FIntPoint));
+        Builder.Update(HP.GetData(), HP.Num() * sizeof(int32));
+        Builder.Update(State.GetData(), State.Num() * sizeof(EAgentState));
+        Builder.Update(TargetId.GetData(), TargetId.Num() * sizeof(int32));
+        return Builder.Finalize().Hash;
+    }
+
+    // Writes or reads NumAgents entries of every column as raw bytes (native byte order).
+    // Loading resizes the columns without shrinking, so their allocations are reused.
+    void SerializeColumns(FArchive& Ar, int32 NumAgents)
+    {
+        SerializeColumn(Ar, Team, NumAgents);
+        SerializeColumn(Ar, State, NumAgents);
+        SerializeColumn(Ar, MaxHP, NumAgents);
+        SerializeColumn(Ar, HP, NumAgents);
+        SerializeColumn(Ar, Cell, NumAgents);
+        SerializeColumn(Ar, PreviousCell, NumAgents);
+        SerializeColumn(Ar, StepsSinceLastAttack, NumAgents);
+        SerializeColumn(Ar, StateSteps, NumAgents);
+        SerializeColumn(Ar, StateDurationSteps, NumAgents);
+        SerializeColumn(Ar, TargetId, NumAgents);
+        SerializeColumn(Ar, PendingDamage, NumAgents);
+    }
+
+    // Bytes SerializeColumns() writes per agent; keep in sync with the column list above
+    static constexpr int32 SerializedBytesPerAgent =
+        sizeof(ETeam) + sizeof(EAgentState) + 2 * sizeof(int32) + 2 * sizeof(FIntPoint) + 5 * sizeof(int32);
+
+    int32 Num() const { return Team.Num(); }
+    bool IsValidId(int32 Id) const { return Team.IsValidIndex(Id); }
+    bool IsAlive(int32 Id) const { return HP[Id] > 0; }
+
+    TArray<ETeam> Team;
+    TArray<EAgentState> State;
+
+    TArray<int32> MaxHP;
+    TArray<int32> HP;
+
+    TArray<FIntPoint> Cell;
+    TArray<FIntPoint> PreviousCell;
+
+    TArray<int32> StepsSinceLastAttack;
+
+    // Steps spent in the current Moving / WaitingForCombat / InCombat state, and how many it lasts
+    TArray<int32> StateSteps;
+    TArray<int32> StateDurationSteps;
+
+    // Target handling
+    TArray<int32> TargetId;
+    TArray<int32> PendingDamage;
+
+private:
+    template<typename ElementType>
+    static void SerializeColumn(FArchive& Ar, TArray<ElementType>& Column, int32 NumAgents)
+    {
+        static_assert(std::is_trivially_copyable_v<ElementType>, "Columns are copied as raw bytes");
+
+        if (Ar.IsLoading())
+        {
+            Column.SetNumUninitialized(NumAgents, EAllowShrinking::No);
+        }
+        Ar.Serialize(Column.GetData(), static_cast<int64>(NumAgents) * sizeof(ElementType));
+    }
+};
+
+struct FSimulationRules
+{
+    float MoveSpeed = 130.f;
+    float AttackCooldown = 0.7f;
+    float PauseBeforeCombatDuration = 1.f;
+
+    // Time from the end of the combat pause until the hit lands
+    float AttackDuration = 0.16f;
+
+    int32 DamagePerAttack = 1;
+    int32 MinSpawnHP = 2;
+    int32 MaxSpawnHP = 5;
+
+    // The durations above in whole simulation steps, see SetStepInterval()
+    int32 AttackCooldownSteps = 7;
+    int32 PauseBeforeCombatSteps = 10;
+    int32 AttackSteps = 2;
+
+    // Number of steps of StepInterval needed to cover Seconds
+    static int32 ToSteps(float Seconds, float StepInterval)
+    {
+        return StepInterval > 0.f ? FMath::Max(FMath::CeilToInt(Seconds / StepInterval - KINDA_SMALL_NUMBER), 0) : 0;
+    }
+
+    void SetStepInterval(float StepInterval)
+    {
+        AttackCooldownSteps = ToSteps(AttackCooldown, StepInterval);
+        PauseBeforeCombatSteps = ToSteps(PauseBeforeCombatDuration, StepInterval);
+        AttackSteps = ToSteps(AttackDuration, StepInterval);
+    }
+};
@@ -0,0 +1,179 @@
+#include "TeamFlowField.h"
+#include "FHexGrid.h"
+#include "FSquareGrid.h"
+
+void FTeamFlowField::Build(const IGridGeometry& Geometry, TConstArrayView<FIntPoint> EnemyCells, TConstArrayView<FIntPoint> SeekerCells, const FPathBlockers& Blockers)
+{
+    if (GridSize != Geometry.GetGridSize())
+    {
+        GridSize = Geometry.GetGridSize();
+        ChunksPerSide = FMath::DivideAndRoundUp(GridSize, ChunkSize);
+        Chunks.Reset();
+        Chunks.SetNum(ChunksPerSide * ChunksPerSide);
+        AllocatedChunks.Reset();
+    }
+
+    // Bounding box of both armies, grown by the margin and rounded out to whole chunks
+    FIntPoint Min(MAX_int32, MAX_int32);
+    FIntPoint Max(MIN_int32, MIN_int32);
+    for (TConstArrayView<FIntPoint> Cells : { EnemyCells, SeekerCells })
+    {
+        for (const FIntPoint& Cell : Cells)
+        {
+            if (Cell.X >= 0 && Cell.X < GridSize && Cell.Y >= 0 && Cell.Y < GridSize)
+            {
+                Min = Min.ComponentMin(Cell);
+                Max = Max.ComponentMax(Cell);
+            }
+        }
+    }
+
+    if (Min.X > Max.X)
+    {
+        Region = FIntRect();
+    }
+    else
+    {
+        Region.Min.X = (FMath::Max(Min.X - RegionMargin, 0) >> ChunkShift) << ChunkShift;
+        Region.Min.Y = (FMath::Max(Min.Y - RegionMargin, 0) >> ChunkShift) << ChunkShift;
+        Region.Max.X = FMath::Min(FMath::DivideAndRoundUp(Max.X + RegionMargin + 1, ChunkSize) * ChunkSize, GridSize);
+        Region.Max.Y = FMath::Min(FMath::DivideAndRoundUp(Max.Y + RegionMargin + 1, ChunkSize) * ChunkSize, GridSize);
+    }
+
+    // The region is whole chunks, so a chunk outside it is never read again until the armies get there
+    AllocatedChunks.RemoveAllSwap([this](int32 ChunkIndex)
+    {
+        const FIntPoint ChunkMin((ChunkIndex % ChunksPerSide) << ChunkShift, (ChunkIndex / ChunksPerSide) << ChunkShift);
+        if (IsInRegion(ChunkMin))
+            return false;
+
+        Chunks[ChunkIndex].Reset();
+        return true;
+    }, EAllowShrinking::No);
+
+    if (++Generation == 0)
+    {
+        for (int32 ChunkIndex : AllocatedChunks)
+        {
+            Chunks[ChunkIndex]->Generation = 0;
+        }
+        Generation = 1;
+    }
+
+    Queue.Reset();
+
+    for (const FIntPoint& Cell : EnemyCells)
+    {
+        if (!IsInRegion(Cell))
+            continue;
+
+        int32& CellDistance = FindOrAddChunk(Cell).Distance[ToLocalIndex(Cell)];
+        if (CellDistance != INDEX_NONE)
+            continue;
+
+        CellDistance = 0;
+        Queue.Add(Cell.Y * GridSize + Cell.X);
+    }
+
+    switch (Geometry.GetShape())
+    {
+    case EGridShape::Hex:
+        Expand(static_cast<const FHexGrid&>(Geometry), Blockers);
+        break;
+    case EGridShape::Square:
+    default:
+        Expand(static_cast<const FSquareGrid&>(Geometry), Blockers);
+        break;
+    }
+}
+
+template<typename GeometryType>
+void FTeamFlowField::Expand(const GeometryType& Geometry, const FPathBlockers& Blockers)
+{
+    for (int32 Head = 0; Head < Queue.Num(); ++Head)
+    {
+        const int32 Index = Queue[Head];
+        const FIntPoint Cell(Index % GridSize, Index / GridSize);
+        const int32 NextDistance = FindChunk(Cell)->Distance[ToLocalIndex(Cell)] + 1;
+
+        Geometry.ForEachNeighbor(Cell, [&](const FIntPoint& Neighbor)
+        {
+            if (!IsInRegion(Neighbor) || Blockers.IsBlocked(Neighbor))
+                return;
+
+            int32& NeighborDistance = FindOrAddChunk(Neighbor).Distance[ToLocalIndex(Neighbor)];
+            if (NeighborDistance != INDEX_NONE)
+                return;
+
+            NeighborDistance = NextDistance;
+            Queue.Add(Neighbor.Y * GridSize + Neighbor.X);
+        });
+    }
+}
+
+const FTeamFlowField::FChunk* FTeamFlowField::FindChunk(const FIntPoint& Cell) const
+{
+    if (!IsInRegion(Cell))
+        return nullptr;
+
+    const FChunk* Chunk = Chunks[ToChunkIndex(Cell)].Get();
+    return Chunk && Chunk->Generation == Generation ? Chunk : nullptr;
+}
+
+FTeamFlowField::FChunk& FTeamFlowField::FindOrAddChunk(const FIntPoint& Cell)
+{
+    const int32 ChunkIndex = ToChunkIndex(Cell);
+    TUniquePtr<FChunk>& Chunk = Chunks[ChunkIndex];
+    if (!Chunk)
+    {
+        Chunk = MakeUnique<FChunk>();
+        AllocatedChunks.Add(ChunkIndex);
+    }
+
+    // First reached by this build; INDEX_NONE is all bits set
+    if (Chunk->Generation != Generation)
+    {
+        FMemory::Memset(Chunk->Distance, 0xFF);
+        Chunk->Generation = Generation;
+    }
+
+    return *Chunk;
+}
+
+int32 FTeamFlowField::GetDistance(const FIntPoint& Cell) const
+{
+    const FChunk* Chunk = FindChunk(Cell);
+    return Chunk ? Chunk->Distance[ToLocalIndex(Cell)] : INDEX_NONE;
+}
+
+bool FTeamFlowField::GetNextStep(const FIntPoint& From, const IGridGeometry& Geometry, const FIntPoint* PreviousCell, FIntPoint& OutNextStep) const
+{
+    int32 BestDistance = MAX_int32;
+    bool bFound = false;
+    bool bBestIsPrevious = false;
+
+    for (const FIntPoint& Neighbor : Geometry.GetNeighbors(From))
+    {
+        const int32 NeighborDistance = GetDistance(Neighbor);
+        if (NeighborDistance == INDEX_NONE)
+            continue;
+
+        const bool bIsPrevious = PreviousCell && Neighbor == *PreviousCell;
+
+        // Any other reachable neighbour beats the previous cell, otherwise the lower distance wins
+        // and equal distances keep the first neighbour found
+        const bool bBetter = !bFound
+            || (bBestIsPrevious && !bIsPrevious)
+            || (bBestIsPrevious == bIsPrevious && NeighborDistance < BestDistance);
+
+        if (bBetter)
+        {
+            BestDistance = NeighborDistance;
+            bBestIsPrevious = bIsPrevious;
+            OutNextStep = Neighbor;
+            bFound = true;
+        }
+    }
+
+    return bFound;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IGridGeometry.h"
+#include "GridLayers.h"
+
+/*
+====================================================================================
+  FTeamFlowField - Multi-source distance field towards a team's enemies
+====================================================================================
+
+- Built once per step and team with a breadth-first search seeded from every living
+  enemy cell, so each cell stores how many steps separate it from the closest enemy.
+- Cells blocked by the FPathBlockers it is given (static obstacles and the cells
+  occupied at the start of the step) are not expanded, the same as for IPathfinder.
+- An agent picks its next cell by comparing the distances of its neighbours, which
+  replaces a FindClosestEnemy + FindPath pair per agent with one search per team.
+
+Notes:
+- Seeds are expanded in the order they are given and neighbours in GetNeighbors()
+  order, so the field (and every tie-break made from it) is deterministic.
+- The search only covers the armies' bounding box grown by RegionMargin cells and
+  rounded out to whole chunks; a route that would have to leave it is not found.
+- Distances are kept in ChunkSize x ChunkSize chunks (16 KB each) allocated the first
+  time the search reaches them, so memory follows the area the armies span rather
+  than the grid size. Chunks outside the next build's region are released.
+*/
+
+class FTeamFlowField
+{
+public:
+    // Expands from EnemyCells through the region around EnemyCells and SeekerCells
+    void Build(const IGridGeometry& Geometry, TConstArrayView<FIntPoint> EnemyCells, TConstArrayView<FIntPoint> SeekerCells, const FPathBlockers& Blockers);
+
+    // Steps from Cell to the closest enemy, or INDEX_NONE if no enemy can be reached
+    int32 GetDistance(const FIntPoint& Cell) const;
+
+    // Picks the neighbour of From closest to an enemy. Stepping back into PreviousCell is only
+    // chosen when nothing else leads to an enemy, mirroring the A* oscillation penalty.
+    bool GetNextStep(const FIntPoint& From, const IGridGeometry& Geometry, const FIntPoint* PreviousCell, FIntPoint& OutNextStep) const;
+
+    int32 GetNumAllocatedChunks() const { return AllocatedChunks.Num(); }
+
+    static constexpr int32 ChunkSize = 64;
+    static constexpr int32 RegionMargin = 64;
+
+private:
+    static constexpr int32 ChunkShift = 6;
+    static constexpr int32 ChunkMask = ChunkSize - 1;
+
+    static_assert(ChunkSize == 1 << ChunkShift, "Chunk coordinates are taken with shifts");
+
+    struct FChunk
+    {
+        // Steps to the closest enemy per cell (LocalY * ChunkSize + LocalX), INDEX_NONE if not reached
+        int32 Distance[ChunkSize * ChunkSize];
+
+        // Build the distances were written in; older ones read as not reached
+        uint32 Generation = 0;
+    };
+
+    // Breadth-first expansion against a concrete geometry, instantiated for FSquareGrid and FHexGrid
+    template<typename GeometryType>
+    void Expand(const GeometryType& Geometry, const FPathBlockers& Blockers);
+
+    bool IsInRegion(const FIntPoint& Cell) const
+    {
+        return Cell.X >= Region.Min.X && Cell.X < Region.Max.X && Cell.Y >= Region.Min.Y && Cell.Y < Region.Max.Y;
+    }
+
+    int32 ToChunkIndex(const FIntPoint& Cell) const
+    {
+        return (Cell.Y >> ChunkShift) * ChunksPerSide + (Cell.X >> ChunkShift);
+    }
+
+    static int32 ToLocalIndex(const FIntPoint& Cell)
+    {
+        return (Cell.Y & ChunkMask) * ChunkSize + (Cell.X & ChunkMask);
+    }
+
+    // Null outside the region and for chunks the current build has not reached
+    const FChunk* FindChunk(const FIntPoint& Cell) const;
+
+    // Cell has to be in the region
+    FChunk& FindOrAddChunk(const FIntPoint& Cell);
+
+    TArray<TUniquePtr<FChunk>> Chunks;
+    TArray<int32> AllocatedChunks;
+    TArray<int32> Queue;
+
+    // Cells the current build covers, Max exclusive
+    FIntRect Region;
+
+    uint32 Generation = 0;
+    int32 GridSize = 0;
+    int32 ChunksPerSide = 0;
+};